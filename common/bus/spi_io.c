@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <string.h>
 
 #include <avr/io.h>
 #include <avr/power.h>
@@ -125,9 +126,12 @@ void spi_putchar(uint8_t ch) {
 }
 
 void spi_puts(const char * string) {
-	while(*string) {
-		spi_putchar(*string);
-		string++;
+	size_t len = strlen(string);
+	while(len) {
+		uint8_t n = list_write(x)(&tx, (const uint8_t *)string,
+				MIN(len, UINT8_MAX));
+		string += n;
+		len -= n;
 	}
 }
 
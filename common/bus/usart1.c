@@ -7,19 +7,31 @@
 #include <avr/interrupt.h>
 #include <util/atomic.h>
 
-#include "queue.h"
+#include "ds/gcirc.h"
 #include "usart1.h"
 #include "usart1_conf.h"
 
-QUEUE_BASE_T _tx_buffer[QUEUE_SZ];
-queue_t tx_q;
+/* Both rings are single producer, single consumer: for tx the main loop
+ * only moves head and the UDRE isr only tail, for rx the RX isr only head
+ * and the main loop only tail. So neither side masks interrupts. Nothing
+ * but usart1_putchar_queue may put to tx, the RX isr leaves echoing to
+ * usart1_getchar_queue. */
+#define NONE
+/*          name, fnattr, dattr, data_t, index_t*/
+LIST_DEFINE(u, static, NONE, uint8_t, uint8_t);
 
-QUEUE_BASE_T _rx_buffer[QUEUE_SZ];
-queue_t rx_q;
+// NEVER ACCESS THESE DIRECTLY (they are used as 'restrict').
+static uint8_t tx_b[USART1_TX_Q_LEN], rx_b[USART1_RX_Q_LEN];
+
+static list_t(u) tx = LIST_INITIALIZER(tx_b);
+static list_t(u) rx = LIST_INITIALIZER(rx_b);
+
+/* bumped by the RX isr for each character it could not keep */
+static volatile uint8_t rx_drops;
 
 static int usart1_getchar_queue(FILE * stream);
-static int usart1_putchar_queue_ts3(char c, FILE *stream);
-static FILE usart1_io_queue = FDEV_SETUP_STREAM(usart1_putchar_queue_ts3, usart1_getchar_queue ,_FDEV_SETUP_RW);
+static int usart1_putchar_queue(char c, FILE *stream);
+static FILE usart1_io_queue = FDEV_SETUP_STREAM(usart1_putchar_queue, usart1_getchar_queue ,_FDEV_SETUP_RW);
 
 static int usart1_getchar_direct(FILE * stream);
 static int usart1_putchar_direct(char c, FILE *stream);
@@ -28,20 +40,15 @@ static FILE usart1_io_direct = FDEV_SETUP_STREAM(usart1_putchar_direct, usart1_g
 inline static void usart_udre_inter_on(void)  { UCSRB |= (uint8_t) (1<<UDRIE); }
 inline static void usart_udre_inter_off(void) { UCSRB &= (uint8_t)~(1<<UDRIE); }
 
-queue_t * _get_queue(uint8_t i) {
-	if (i == 0)
-		return &tx_q;
-	else if (i == 1)
-		return &rx_q;
-	else return NULL;
-}
-
+/* the consumer's flush: drops what is there, the isr keeps head */
 void usart1_flush_rx( void ) {
-    q_flush(&rx_q);
+	list_drop(u)(&rx, LIST_CT(rx));
 }
 
+/* head = tail would race the isr moving tail, so stop it first. */
 void usart1_flush_tx( void ) {
-    q_flush(&tx_q);
+	usart_udre_inter_off();
+	list_flush(u)(&tx);
 }
 
 static int usart1_putchar_direct(char c, FILE *stream) {
@@ -52,43 +59,46 @@ static int usart1_putchar_direct(char c, FILE *stream) {
 	return 0;
 }
 
+/* Echoes what it hands out, the RX isr can't (it would be a second
+ * producer for tx). A bell for characters the isr dropped since the last
+ * call. */
 static int usart1_getchar_queue(FILE *stream) {
-	if ( !q_empty(&rx_q) )
-		return q_pop(&rx_q);
-	else
+	static uint8_t drops_seen;
+	uint8_t drops = rx_drops;
+	if (drops != drops_seen) {
+		drops_seen = drops;
+		fputc('\a', &usart1_io_queue);
+	}
+
+	if (list_empty(u)(&rx))
 		return _FDEV_EOF;
+
+	char c = list_get(u)(&rx);
+	if (c == '\b') {
+		fputc('\b',&usart1_io_queue);
+		fputc(' ' ,&usart1_io_queue);
+	}
+	fputc(c,&usart1_io_queue);
+	return c;
 }
 
-static int usart1_putchar_queue_ts3(char c, FILE *stream) {	if (c == '\n')
+/* The isr turning UDRIE off can't lose a character: it only does so on
+ * seeing tx empty, and UDRIE is set again after every put. */
+static int usart1_putchar_queue(char c, FILE *stream) {
+	if (c == '\n')
 		putc('\r', stream);
 
-	uint8_t sreg = SREG;
-	cli();
-	if ( q_full(&tx_q) ) {
-		usart_udre_inter_on();
-		while ( q_full(&tx_q) ) {
-			sei();
-			asm(
-				"nop" "\n\t"
-				"nop" "\n\t"
-			);
-			cli();
-		}
-		q_push(&tx_q,c);
-		SREG = sreg;
-		return 0;
+	while (list_full(u)(&tx)) {
+		asm volatile("":::"memory");
 	}
-	q_push(&tx_q,c);
+	list_put(u)(&tx,c);
 	usart_udre_inter_on();
-	SREG = sreg;
 	return 0;
 }
 
 void usart1_init(void) {
 	power_usart_enable();
 
-	q_init(&tx_q, _tx_buffer, QUEUE_SZ);
-	q_init(&rx_q, _rx_buffer, QUEUE_SZ);
 	/* Set baud rate (12bit) */
 	UBRR   = UBRR_VALUE;
 	#if USE_2X
@@ -116,9 +126,9 @@ void usart1_init(void) {
 }
 
 ISR(USART_UDRE_vect) {
-	if (tx_q.ct>0) // !q_empty(&tx_q)
-		UDR = q_pop(&tx_q);
-	if (tx_q.ct<=0)// q_empty(&tx_q)
+	if (!list_empty(u)(&tx))
+		UDR = list_get(u)(&tx);
+	if (list_empty(u)(&tx))
 		usart_udre_inter_off();
 }
 
@@ -130,15 +140,11 @@ ISR(USART_RX_vect) {
 
 	c = UDR;
 
-	if ( !q_full(&rx_q) && !( ucsra &(1<<FE1) || ucsra & (1<<DOR1) ) ) {
+	if ( !list_full(u)(&rx) && !( ucsra &(1<<FE1) || ucsra & (1<<DOR1) ) ) {
 
-		// Characters that require response.
-		if ( c == '\b' || c == 0x7f )	{	// backspace
-			q_remove(&rx_q);
-			fputc('\b',&usart1_io_queue);
-			fputc(' ' ,&usart1_io_queue);
-			fputc('\b',&usart1_io_queue);
-		}
+		// backspace, echoed as "\b \b" by usart1_getchar_queue
+		if ( c == 0x7f )
+			c = '\b';
 
         	if ( c == '\r') c = '\n';
 
@@ -147,13 +153,11 @@ ISR(USART_RX_vect) {
             // copy to some type of message buffer?
 		}
 
-        	q_push(&rx_q,c);
-		fputc(c,&usart1_io_queue);
-
+		list_put(u)(&rx,c);
 	}
 	else {
-	    // Return 'alarm' characters when the queue is full / error occoured.
-		fputc('\a', &usart1_io_queue);
+	    // 'alarm' characters when the queue is full / error occoured.
+		rx_drops++;
 	}
 }
 
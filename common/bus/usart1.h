@@ -11,14 +11,15 @@ USART
 #define BAUD 38400
 #include <util/setbaud.h>
 
+/* stdin (the queued stream) is raw, not line edited: the RX isr can't
+ * take back a character already queued. A backspace (or DEL) reaches the
+ * reader as '\b', echoed as "\b \b", and the reader must drop its own
+ * last character. */
 void usart1_init(void);
 
 void usart1_flush_rx( void );
 void usart1_flush_tx( void );
 
-#include "queue.h"
-queue_t * _get_queue(uint8_t);
-
 uint8_t usart_msg;
 
 #endif
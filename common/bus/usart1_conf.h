@@ -1,5 +1,9 @@
 #define USART_NUMBER	1
 
+// ring sizes, powers of 2 up to 128
+#define USART1_TX_Q_LEN 64
+#define USART1_RX_Q_LEN 32
+
 #define EV(x) (x)
 
 #define U_A(_A)	COMB2(_A, EV(USART_NUMBER) )
@@ -0,0 +1,23 @@
+#include <stdint.h>
+#include "crc16.h"
+
+/* crc_ccitt_nibble_tbl[n] is the crc of the nibble n shifted through the
+ * register; see crc_ccitt_update(). */
+#if defined(AVR)
+const uint16_t crc_ccitt_nibble_tbl[16] PROGMEM = {
+#else
+const uint16_t crc_ccitt_nibble_tbl[16] = {
+#endif
+	0x0000, 0x1021, 0x2042, 0x3063,
+	0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b,
+	0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+uint16_t crc_ccitt(uint16_t crc, const void *data, uint16_t len)
+{
+	const uint8_t *d = data;
+	while (len--)
+		crc = crc_ccitt_update(crc, *d++);
+	return crc;
+}
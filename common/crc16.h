@@ -0,0 +1,36 @@
+#ifndef CRC16_H_
+#define CRC16_H_ 1
+#include <stdint.h>
+
+/* CRC-16/CCITT: poly 0x1021 (x^16 + x^12 + x^5 + 1), init 0xffff, msb
+ * first, no final xor.
+ *
+ * Appending the crc to the data it covers (high byte first) and running the
+ * same calculation over the result yields CRC_CCITT_GOOD.
+ *
+ * The table lookup is done a nibble at a time so the table is only 16 words
+ * and each byte costs a fixed number of cycles, which makes the update
+ * usable from within an ISR.
+ */
+#define CRC_CCITT_INIT 0xffff
+#define CRC_CCITT_GOOD 0x0000
+
+#if defined(AVR)
+# include <avr/pgmspace.h>
+# define crc_ccitt_tbl_read(i) pgm_read_word(&crc_ccitt_nibble_tbl[(i)])
+extern const uint16_t crc_ccitt_nibble_tbl[16] PROGMEM;
+#else
+# define crc_ccitt_tbl_read(i) (crc_ccitt_nibble_tbl[(i)])
+extern const uint16_t crc_ccitt_nibble_tbl[16];
+#endif
+
+static inline uint16_t crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	crc = (crc << 4) ^ crc_ccitt_tbl_read((uint8_t)(crc >> 12) ^ (data >> 4));
+	crc = (crc << 4) ^ crc_ccitt_tbl_read((uint8_t)(crc >> 12) ^ (data & 0x0f));
+	return crc;
+}
+
+uint16_t crc_ccitt(uint16_t crc, const void *data, uint16_t len);
+
+#endif
@@ -9,7 +9,7 @@
 #define CIRC_SPACE(head,tail,size) CIRC_CNT((tail),((head)+1),(size))
 
 /* is circ_buf full */
-#define CIRC_FULL(head,tail,size) (CIRC_NEXT(tail,size) == (head))
+#define CIRC_FULL(head,tail,size) (CIRC_NEXT(head,size) == (tail))
 
 /* next index (head/tail) location */
 #define CIRC_NEXT(index,size) CIRC_NEXT_I(index,1,size)
@@ -19,14 +19,15 @@
 #define CIRC_NEXT_EQ(index,size) CIRC_NEXT_I_EQ(index,1,size)
 #define CIRC_NEXT_I_EQ(index,isz,size) ((index) = (((index) + (isz)) & ((size - 1))))
 
+/* in at least an int, so a 256 entry ring with uint8_t indexes works */
 #define CIRC_CNT_TO_END(head,tail,size) \
-	({typeof(head) end = (size) - (tail); \
-	  typeof(head) n = ((head) + end) & ((size) - 1); \
+	({typeof((head) + 0) end = (size) - (tail); \
+	  typeof((head) + 0) n = ((head) + end) & ((size) - 1); \
 	  n < end ? n : end;})
 
 #define CIRC_SPACE_TO_END(head,tail,size) \
-	({typeof(head) end = (size) - 1 - (head); \
-	  typeof(head) n = (end + (tail)) & ((size)-1); \
+	({typeof((head) + 0) end = (size) - 1 - (head); \
+	  typeof((head) + 0) n = (end + (tail)) & ((size)-1); \
 	  n <= end ? n : end+1;})
 
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "circ_buf.h"
 
 #define likely(x)       __builtin_expect((x),1)
@@ -11,6 +12,39 @@
 
 #define CAT3(x,y,z) x##y##z
 
+/* With LIST_ATOMIC defined before this is included, head and tail are C11
+ * atomics, each on a cache line of its own (LIST_CACHE_LINE bytes), loaded
+ * with acquire and stored with release ordering. One thread may then
+ * list_put/list_write/list_drop... while another list_get/list_read,
+ * without locks. That is for host programs; the AVR rings rely on a single
+ * byte index store being atomic.
+ *
+ * In either mode only the queue order (list_put/list_get and the bulk
+ * operators) may be split between two sides, popf and pushb move the other
+ * side's index. Every operator touches the buffer before the barrier and
+ * the store of its own index, so the other side (an isr) never sees an
+ * index ahead of the data. */
+#if defined(LIST_ATOMIC)
+# if __STDC_VERSION__ < 201112L
+#  error "LIST_ATOMIC needs C11 (-std=gnu11)"
+# endif
+# include <stdatomic.h>
+# ifndef LIST_CACHE_LINE
+#  define LIST_CACHE_LINE 64
+# endif
+# define _L_INDEX_T(_index_t_) _Alignas(LIST_CACHE_LINE) _Atomic _index_t_
+# define _L_GET(x) atomic_load_explicit(&(x), memory_order_acquire)
+# define _L_SET(x,v) atomic_store_explicit(&(x), (v), memory_order_release)
+# define _L_ONCE(x) _L_GET(x)
+#else
+# define _L_INDEX_T(_index_t_) _index_t_
+# define _L_GET(x) (x)
+# define _L_SET(x,v) ((x) = (v))
+/* read an index the other side (an isr) may be moving, exactly once */
+# define _L_ONCE(x) (*(volatile typeof(x) *)&(x))
+#endif
+#define _L_BARRIER() asm volatile("":::"memory")
+
 typedef int8_t list_error_t;
 
 #define LIST_ERROR_NORET LIST_ERROR
@@ -28,9 +62,9 @@ typedef int8_t list_error_t;
 #define _L_DEF_STRUCT(_name_,dattr,_data_t_,_index_t_) \
 	typedef struct {                         \
 		_data_t_ *const restrict buffer; \
-		_index_t_ head;                  \
-		_index_t_ tail;                  \
 		const _index_t_ size;            \
+		_L_INDEX_T(_index_t_) head;      \
+		_L_INDEX_T(_index_t_) tail;      \
 	} dattr list_t(_name_);
 
 #define LIST_INITIALIZER(buff) {             \
@@ -61,71 +95,133 @@ typedef int8_t list_error_t;
 #define list_peekf(_name_) CAT3(list_,_name_,_peek_front)
 #define list_peek(_name_)  CAT3(list_,_name_,_peek)
 
+#define list_read(_name_)      CAT3(list_,_name_,_read)
+#define list_write(_name_)     CAT3(list_,_name_,_write)
+#define list_peek_span(_name_) CAT3(list_,_name_,_peek_span)
+#define list_drop(_name_)      CAT3(list_,_name_,_drop)
+
 #define list_flush(_name_)   CAT3(list_,_name_,_flush)
 #define list_full(_name_)    CAT3(list_,_name_,_full)
 #define list_empty(_name_)   CAT3(list_,_name_,_empty)
 #define list_valid_i(_name_) CAT3(list_,_name_,_valid_index)
 
 /* Function generators */
+
+/* Bulk operators, for the queue order (list_put/list_get). Each moves up to
+ * len elements with at most 2 memcpy()s and stores its own index once, after
+ * the copy, so one reader and one writer (say an isr) may share a list.
+ * They return the number of elements moved. */
 #define _L_DEF_READ(_name_,_data_t_,_index_t_) \
 __unused _index_t_ list_read(_name_)(list_t(_name_) *l, _data_t_ *buf, _index_t_ len) {\
+	_index_t_ head = _L_ONCE(l->head), tail = _L_GET(l->tail);    \
+	_index_t_ ct = CIRC_CNT(head, tail, l->size);                 \
+	if (len > ct)                                                 \
+		len = ct;                                             \
+	_index_t_ to_end = CIRC_CNT_TO_END(head, tail, l->size);      \
+	if (to_end > len)                                             \
+		to_end = len;                                         \
+	memcpy(buf, l->buffer + tail, to_end * sizeof(*buf));         \
+	memcpy(buf + to_end, l->buffer, (len - to_end) * sizeof(*buf)); \
+	_L_BARRIER();                                                 \
+	_L_SET(l->tail, (tail + len) & (l->size - 1));                \
+	return len;                                                   \
+}
 
+#define _L_DEF_WRITE(_name_,_data_t_,_index_t_) \
+__unused _index_t_ list_write(_name_)(list_t(_name_) *l, const _data_t_ *buf, _index_t_ len) {\
+	_index_t_ head = _L_GET(l->head), tail = _L_ONCE(l->tail);    \
+	_index_t_ space = CIRC_SPACE(head, tail, l->size);            \
+	if (len > space)                                              \
+		len = space;                                          \
+	_index_t_ to_end = CIRC_SPACE_TO_END(head, tail, l->size);    \
+	if (to_end > len)                                             \
+		to_end = len;                                         \
+	memcpy(l->buffer + head, buf, to_end * sizeof(*buf));         \
+	memcpy(l->buffer, buf + to_end, (len - to_end) * sizeof(*buf)); \
+	_L_BARRIER();                                                 \
+	_L_SET(l->head, (head + len) & (l->size - 1));                \
+	return len;                                                   \
+}
+
+/* the elements list_get would return next, in place: *len of them from
+ * the returned pointer (less than LIST_CT when they wrap, 0 if empty).
+ * Release them with list_drop. */
+#define _L_DEF_PEEK_SPAN(_name_,_data_t_,_index_t_) \
+__unused _data_t_ *list_peek_span(_name_)(list_t(_name_) *l, _index_t_ *len) {\
+	_index_t_ head = _L_ONCE(l->head), tail = _L_GET(l->tail);    \
+	*len = CIRC_CNT_TO_END(head, tail, l->size);                  \
+	return l->buffer + tail;                                      \
+}
+
+/* n must be no more than LIST_CT */
+#define _L_DEF_DROP(_name_,_index_t_) \
+__unused void list_drop(_name_)(list_t(_name_) *l, _index_t_ n) {\
+	_L_BARRIER();                                                 \
+	_L_SET(l->tail, (_L_GET(l->tail) + n) & (l->size - 1));       \
+}
 
-#define _L_DEF_POPF(_name_,_data_t_)               \
+#define _L_DEF_POPF(_name_,_data_t_,_index_t_)     \
 __unused _data_t_ list_popf(_name_)(list_t(_name_) *l) {    \
-	l->head = (l->head - 1) & (l->size - 1);   \
-	_data_t_ head = l->buffer[ l->head ];      \
-	return head;                               \
+	_index_t_ head = (_L_GET(l->head) - 1) & (l->size - 1); \
+	_data_t_ x = l->buffer[ head ];            \
+	_L_BARRIER();                              \
+	_L_SET(l->head, head);                     \
+	return x;                                  \
 }
 
-/* the (l->end >= l->sz) is a check for overflow. */
-#define _L_DEF_POPB(_name_,_data_t_)                \
+#define _L_DEF_POPB(_name_,_data_t_,_index_t_)      \
 __unused _data_t_ list_popb(_name_)(list_t(_name_) *l) {     \
-	_data_t_ last = l->buffer[l->tail];     \
-	l->tail = (l->tail + 1) & (l->size - 1);\
+	_index_t_ tail = _L_GET(l->tail);       \
+	_data_t_ last = l->buffer[tail];        \
+	_L_BARRIER();                           \
+	_L_SET(l->tail, (tail + 1) & (l->size - 1)); \
 	return last;                            \
 }
 
-#define _L_DEF_PUSHF(_name_,_data_t_)   \
+#define _L_DEF_PUSHF(_name_,_data_t_,_index_t_) \
 __unused void list_pushf(_name_)(list_t(_name_) *l, _data_t_ x) { \
-	l->buffer[ l->head ] = x;                \
-	l->head = (l->head + 1) & (l->size - 1); \
+	_index_t_ head = _L_GET(l->head);        \
+	l->buffer[ head ] = x;                   \
+	_L_BARRIER();                            \
+	_L_SET(l->head, (head + 1) & (l->size - 1)); \
 }
 
-#define _L_DEF_PUSHB(_name_,_data_t_) \
+#define _L_DEF_PUSHB(_name_,_data_t_,_index_t_) \
 __unused void list_pushb(_name_)(list_t(_name_) *l, _data_t_ x) {\
-	l->tail = (l->tail - 1) & (l->size - 1); \
-	l->buffer[ l->tail ] = x;                \
+	_index_t_ tail = (_L_GET(l->tail) - 1) & (l->size - 1); \
+	l->buffer[ tail ] = x;                   \
+	_L_BARRIER();                            \
+	_L_SET(l->tail, tail);                   \
 }
 
 #define _L_DEF_PEEKF(_name_,_data_t_)   \
 __unused _data_t_ list_peekf(_name_)(list_t(_name_) *l) {\
-	return l->buffer[(l->head - 1) & (l->size - 1)]; \
+	return l->buffer[(_L_GET(l->head) - 1) & (l->size - 1)]; \
 }
 
 #define _L_DEF_PEEKB(_name_,_data_t_,_index_t_)  \
 __unused _data_t_ list_peekb(_name_)(list_t(_name_) *l) {\
-	return l->buffer[l->tail];               \
+	return l->buffer[_L_GET(l->tail)];       \
 }
 
 #define _L_DEF_PEEK(_name_,_data_t_,_index_t_)  \
 __unused _data_t_ list_peek(_name_)(list_t(_name_) *l, _index_t_ index) {\
-	return l->buffer[ (l->head - 1 + index) & (l->size - 1)]; \
+	return l->buffer[ (_L_GET(l->head) - 1 - index) & (l->size - 1)]; \
 }
 
 /* Can be called from non-isr with probably no bad occourances. */
 #define _L_DEF_FLUSH(_name_)                             \
 __unused void list_flush(_name_)(list_t(_name_) *list) { \
-	list->head = list->tail;                         \
+	_L_SET(list->head, _L_GET(list->tail));          \
 }
 
 #define LIST_FLUSH(_list_) do {          \
-	(_list_)->head = (_list_)->tail; \
+	_L_SET((_list_)->head, _L_GET((_list_)->tail)); \
 	} while(0)
 
 #define _L_DEF_EMPTY(_name_)                             \
 __unused bool list_empty(_name_)(list_t(_name_) *list) { \
-	if ( likely( list->head != list->tail ) )        \
+	if ( likely( _L_GET(list->head) != _L_GET(list->tail) ) ) \
 		return false;                            \
 	else                                             \
 		return true;                             \
@@ -136,18 +232,19 @@ __unused bool list_empty(_name_)(list_t(_name_) *list) { \
 
 #define _L_DEF_FULL(_name_)                                                \
 __unused bool list_full(_name_)(list_t(_name_) *list) {                    \
-	if ( likely( (CIRC_NEXT(list->head,list->size) !=  list->tail )) ) \
+	if ( likely( (CIRC_NEXT(_L_GET(list->head),list->size) !=          \
+			_L_GET(list->tail) )) )                            \
 		return false;                                              \
 	else                                                               \
 		return true;                                               \
 }
 
 #define LIST_FULL(_list_) \
-	((CIRC_NEXT((_list_)->head,(_list_)->size) == (_list_)->tail )
+	(CIRC_NEXT((_list_)->head,(_list_)->size) == (_list_)->tail)
 
 #define _L_DEF_VAL_I(_name_, _index_t_)  \
 __unused bool list_valid_i(_name_)(list_t(_name_) *list, _index_t_ i) {\
-	if ( CIRC_CNT(list->head,list->tail,list->size) > i ) \
+	if ( CIRC_CNT(_L_GET(list->head),_L_GET(list->tail),list->size) > i ) \
 		return true;  \
 	else                  \
 		return false; \
@@ -160,14 +257,18 @@ __unused bool list_valid_i(_name_)(list_t(_name_) *list, _index_t_ i) {\
 	_L_DEF_STRUCT(_name_,dattr,_data_t_,_index_t_)   \
 	fnattr _L_DEF_EMPTY (_name_)                     \
 	fnattr _L_DEF_FULL  (_name_)                     \
-	fnattr _L_DEF_POPF  (_name_,_data_t_)            \
-	fnattr _L_DEF_POPB  (_name_,_data_t_)            \
-	fnattr _L_DEF_PUSHF (_name_,_data_t_)            \
-	fnattr _L_DEF_PUSHB (_name_,_data_t_)            \
+	fnattr _L_DEF_POPF  (_name_,_data_t_,_index_t_)  \
+	fnattr _L_DEF_POPB  (_name_,_data_t_,_index_t_)  \
+	fnattr _L_DEF_PUSHF (_name_,_data_t_,_index_t_)  \
+	fnattr _L_DEF_PUSHB (_name_,_data_t_,_index_t_)  \
 	fnattr _L_DEF_PEEKF (_name_,_data_t_)            \
 	fnattr _L_DEF_PEEKB (_name_,_data_t_,_index_t_)  \
 	fnattr _L_DEF_PEEK  (_name_,_data_t_,_index_t_)  \
 	fnattr _L_DEF_VAL_I (_name_,_index_t_)           \
+	fnattr _L_DEF_READ  (_name_,_data_t_,_index_t_)  \
+	fnattr _L_DEF_WRITE (_name_,_data_t_,_index_t_)  \
+	fnattr _L_DEF_PEEK_SPAN(_name_,_data_t_,_index_t_) \
+	fnattr _L_DEF_DROP  (_name_,_index_t_)           \
 	fnattr _L_DEF_FLUSH (_name_)
 
 #endif
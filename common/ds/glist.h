@@ -99,15 +99,18 @@ __unused void list_pushf(_name_)(list_t(_name_) *l, _data_t_ x) { \
 	l->buffer[ l->first ] = x;       \
 }
 
+/* when full, the back is overwritten. */
 #define _L_DEF_PUSHFO(_name_,_data_t_) \
 __unused void list_pushfo(_name_)(list_t(_name_) *l, _data_t_ x) {\
-	if ( !list_full(_name_)(l) ) { \
-		l->ct++;               \
-	}                              \
+	bool full = list_full(_name_)(l); \
 	l->first--;                    \
 	if( l->first >= l->sz )        \
 		l->first = l->sz - 1;  \
 	l->buffer[ l->first ] = x;     \
+	if ( full )                    \
+		l->end = l->first;     \
+	else                           \
+		l->ct++;               \
 }
 
 #define _L_DEF_PUSHB(_name_,_data_t_) \
@@ -192,7 +195,7 @@ __unused bool list_full(_name_)(list_t(_name_) *list) { \
 
 #define _L_DEF_VAL_I(_name_, _index_t_)  \
 __unused bool list_valid_i(_name_)(list_t(_name_) *list, _index_t_ i) {\
-	if ( likely( list->ct > i && i > 0 ) ) \
+	if ( likely( list->ct > i ) )          \
 		return true;  \
 	else                  \
 		return false; \
@@ -61,10 +61,9 @@ list_error_t list_push_front(list_t *l, list_base_t x) {
 	return 0;
 }
 
+// when full, the back is overwritten
 void list_push_front_o(list_t *l, list_base_t x) {
-	if ( !list_full(l) ) {
-		l->ct++;
-	}
+	bool full = list_full(l);
 
 	l->first--;
 	if( l->first >= l->sz )
@@ -72,6 +71,10 @@ void list_push_front_o(list_t *l, list_base_t x) {
 
 	l->buffer[ l->first ] = x;
 
+	if (full)
+		l->end = l->first;
+	else
+		l->ct++;
 }
 
 list_error_t list_push_back(list_t *l, list_base_t x) {
@@ -91,6 +94,7 @@ list_error_t list_push_back(list_t *l, list_base_t x) {
 	return 0;
 }
 
+// when full, the front is overwritten
 void list_push_back_o(list_t *l, list_base_t x) {
 	l->buffer[ l->end ] = x;
 
@@ -98,10 +102,10 @@ void list_push_back_o(list_t *l, list_base_t x) {
 	if ( l->end >= l->sz )
 		l->end = 0;
 
-	if (!list_full(l))
+	if (list_full(l))
+		l->first = l->end;
+	else
 		++(l->ct);
-	
-	return;
 }
 
 list_base_t list_peek_front(list_t *l) {
@@ -163,7 +167,7 @@ bool list_full(list_t *list) {
 }
 
 bool list_valid_index(list_t *list, list_index_t i) {
-	if ( likely( list->ct > i && i > 0 ) ) return true;
+	if ( likely( list->ct > i ) ) return true;
 	else return false;
 
 }
@@ -47,6 +47,7 @@ list_base_t list_peek(list_t *list, list_index_t index);
 void list_flush(list_t *list);
 bool list_empty(list_t *list);
 bool list_full(list_t *list);
+bool list_valid_index(list_t *list, list_index_t i);
 
 #endif
 
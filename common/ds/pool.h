@@ -0,0 +1,170 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+/* pool.h
+ * Fixed size blocks, reference counted, so a buffer filled by one driver
+ * can be handed on to another (and another) instead of copied, and freed
+ * when the last of them lets go.
+ *
+ * POOL_DECLARE(name, count, size) in a header, POOL_DEFINE(name, count,
+ * size) after it in one .c, then:
+ *   p = pool_alloc(name)()   a block of size bytes with 1 reference, or
+ *                            NULL when none are free.
+ *   pool_ref(name)(p)        one more reference, returns p.
+ *   pool_unref(name)(p)      one less, the block is free again at 0.
+ *   pool_refs(name)(p)       references held on p.
+ *   pool_used(name)(), pool_peak(name)()
+ *                            blocks out now, and the most out at once.
+ *
+ * All are O(1) and may be called from isrs: each is a few instructions
+ * under POOL_LOCK, by default ATOMIC_BLOCK on AVR and nothing on the host
+ * (one thread; define POOL_LOCK to take a lock for more). count is at most
+ * 255.
+ *
+ * A block holds at most 255 references. pool_ref() past that, or of a free
+ * block, and pool_unref() of a free block are ignored rather than let
+ * corrupt the free stack, and trip POOL_ASSERT: assert() on the host,
+ * nothing on AVR unless it is defined.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef POOL_LOCK
+# if defined(__AVR__)
+#  include <util/atomic.h>
+#  define POOL_LOCK ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+# else
+#  define POOL_LOCK
+# endif
+#endif
+
+#ifndef POOL_ASSERT
+# if defined(__AVR__)
+#  define POOL_ASSERT(x) ((void)0)
+# else
+#  include <assert.h>
+#  define POOL_ASSERT(x) assert(x)
+# endif
+#endif
+
+#ifndef CAT3
+# define CAT3(x,y,z) x##y##z
+#endif
+
+#define pool_v(_name_)     CAT3(pool_,_name_,_v)
+#define pool_alloc(_name_) CAT3(pool_,_name_,_alloc)
+#define pool_ref(_name_)   CAT3(pool_,_name_,_ref)
+#define pool_unref(_name_) CAT3(pool_,_name_,_unref)
+#define pool_refs(_name_)  CAT3(pool_,_name_,_refs)
+#define pool_used(_name_)  CAT3(pool_,_name_,_used)
+#define pool_peak(_name_)  CAT3(pool_,_name_,_peak)
+
+/* the block size and count, as constants */
+#define POOL_SZ(_name_) CAT3(POOL_,_name_,_SZ)
+#define POOL_CT(_name_) CAT3(POOL_,_name_,_CT)
+
+#define POOL_DECLARE(_name_, _count_, _size_)				\
+	enum {								\
+		POOL_SZ(_name_) = (_size_),				\
+		POOL_CT(_name_) = (_count_),				\
+	};								\
+	void *pool_alloc(_name_)(void);					\
+	void *pool_ref(_name_)(void *p);				\
+	void pool_unref(_name_)(void *p);				\
+	uint8_t pool_refs(_name_)(const void *p);			\
+	uint8_t pool_used(_name_)(void);				\
+	uint8_t pool_peak(_name_)(void);
+
+/* Blocks are handed out from the free stack, or failing that the first
+ * never used one (fresh), so the zeroed pool needs no init. */
+#define _P_DEF_STORE(_name_, _count_, _size_)				\
+	_Static_assert((_count_) > 0 && (_count_) < 256,		\
+			"pool count must be 1 to 255");			\
+	static struct {							\
+		uint8_t data[_count_][_size_]				\
+			__attribute__((aligned(sizeof(void *))));	\
+		uint8_t ref[_count_];					\
+		uint8_t free[_count_];					\
+		uint8_t nfree;						\
+		uint8_t fresh;						\
+		uint8_t used;						\
+		uint8_t peak;						\
+	} pool_v(_name_);
+
+#define _P_INDEX(_name_, p)						\
+	((uint8_t)(((const uint8_t *)(p) - pool_v(_name_).data[0]) /	\
+			POOL_SZ(_name_)))
+
+#define _P_DEF_ALLOC(_name_)						\
+void *pool_alloc(_name_)(void)						\
+{									\
+	uint8_t i = POOL_CT(_name_);					\
+	POOL_LOCK {							\
+		if (pool_v(_name_).nfree)				\
+			i = pool_v(_name_).free[--pool_v(_name_).nfree]; \
+		else if (pool_v(_name_).fresh < POOL_CT(_name_))	\
+			i = pool_v(_name_).fresh++;			\
+		if (i < POOL_CT(_name_)) {				\
+			pool_v(_name_).ref[i] = 1;			\
+			if (++pool_v(_name_).used > pool_v(_name_).peak) \
+				pool_v(_name_).peak = pool_v(_name_).used; \
+		}							\
+	}								\
+	return i < POOL_CT(_name_) ? pool_v(_name_).data[i] : NULL;	\
+}
+
+#define _P_DEF_REF(_name_)						\
+void *pool_ref(_name_)(void *p)						\
+{									\
+	uint8_t i = _P_INDEX(_name_, p);				\
+	bool ok;							\
+	POOL_LOCK {							\
+		uint8_t r = pool_v(_name_).ref[i];			\
+		ok = r && r != UINT8_MAX;				\
+		if (ok)							\
+			pool_v(_name_).ref[i] = r + 1;			\
+	}								\
+	POOL_ASSERT(ok);						\
+	return p;							\
+}
+
+#define _P_DEF_UNREF(_name_)						\
+void pool_unref(_name_)(void *p)					\
+{									\
+	uint8_t i = _P_INDEX(_name_, p);				\
+	bool ok;							\
+	POOL_LOCK {							\
+		uint8_t r = pool_v(_name_).ref[i];			\
+		ok = r;							\
+		if (ok && !(pool_v(_name_).ref[i] = r - 1)) {		\
+			pool_v(_name_).free[pool_v(_name_).nfree++] = i; \
+			pool_v(_name_).used--;				\
+		}							\
+	}								\
+	POOL_ASSERT(ok);						\
+}
+
+#define _P_DEF_STATS(_name_)						\
+uint8_t pool_refs(_name_)(const void *p)				\
+{									\
+	return pool_v(_name_).ref[_P_INDEX(_name_, p)];			\
+}									\
+uint8_t pool_used(_name_)(void)						\
+{									\
+	return pool_v(_name_).used;					\
+}									\
+uint8_t pool_peak(_name_)(void)						\
+{									\
+	return pool_v(_name_).peak;					\
+}
+
+#define POOL_DEFINE(_name_, _count_, _size_)				\
+	_P_DEF_STORE(_name_, _count_, _size_)				\
+	_P_DEF_ALLOC(_name_)						\
+	_P_DEF_REF(_name_)						\
+	_P_DEF_UNREF(_name_)						\
+	_P_DEF_STATS(_name_)
+
+#endif
@@ -18,12 +18,11 @@ QUEUE_BASE_T q_remove(queue_t *q) {
 		return 0;
 	}
 	else {
-		QUEUE_BASE_T old = q->buffer[q->last];
 		q->ct--;
 		q->last--;
-		if ( q->last > 0)
-			q->last = q->sz;
-		return old;
+		if ( q->last >= q->sz ) // if overflowed
+			q->last = q->sz - 1;
+		return q->buffer[q->last];
 	}
 }
 
@@ -54,7 +53,9 @@ int8_t q_push_o(queue_t *q, QUEUE_BASE_T x)
 	if ( q->last >= q->sz )
 		q->last = 0;
 
-	if (!q_full(q))
+	if (q_full(q)) // the oldest was overwritten
+		q->first = q->last;
+	else
 		++(q->ct);
      return 0;
 }
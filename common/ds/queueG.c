@@ -1,33 +1,48 @@
-/* queue.c
-	functions for static FIFO implimentation.
+/* queueG.c
+	functions for static FIFO implimentation, of any item type.
 */
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
-#include "queue.h"
+#include "queueG.h"
+
+#define q_item(q, i) ((q)->buffer + (uint16_t)(i) * (q)->item_sz)
 
 void q_flush(queue_t *q) {
 	q->first = q->last;
 	q->ct = 0;
 }
 
-QUEUE_BASE_T q_pop(queue_t *q) {
+QUEUE_BASE_PT q_peak(queue_t *q, QUEUE_INDEX_T pos) {
+	if (pos >= q->ct)
+		return NULL;
+	uint16_t i = q->first + pos;
+	if ( i >= q->len )
+		i -= q->len;
+	return q_item(q, i);
+}
+
+QUEUE_BASE_PT q_peak_fst(queue_t *q) {
+	return q_peak(q, 0);
+}
+
+QUEUE_BASE_PT q_pop(queue_t *q) {
 // take the last thing that was put on
 	if (q_empty(q)) {
 		return NULL;
 	}
 	else {
-		QUEUE_BASE_T old = q->buffer[q->last];
 		q->ct--;
 		q->last--;
-		if ( q->last > 0)
-			q->last = q->len;
-		return old;
+		if ( q->last >= q->len ) // if overflowed
+			q->last = q->len - 1;
+		return q_item(q, q->last);
 	}
 }
 
-QUEUE_BASE_T q_get(queue_t *q) {
+QUEUE_BASE_PT q_get(queue_t *q) {
 	if (q_empty(q)) {
 		#if (defined(io_isr))
 		fprintf(io_isr,"\n{warn: pop}");
@@ -35,8 +50,7 @@ QUEUE_BASE_T q_get(queue_t *q) {
 		return NULL;
 	}
 	else {
-		QUEUE_BASE_T x;
-		x = q->buffer[ q->first ];
+		QUEUE_BASE_PT x = q_item(q, q->first);
 		q->first++;
 		if ( q->first >= q->len )
 			q->first = 0;
@@ -46,36 +60,54 @@ QUEUE_BASE_T q_get(queue_t *q) {
 	}
 }
 
-int8_t q_push(queue_t *q, QUEUE_BASE_T x)
+int8_t q_push(queue_t *q, const void *x)
 {
 	if (q_full(q)){
 	     #if (defined(io_isr))
-	     fprintf(io_isr,"\n{warn: push (%d)}",x);
+	     fprintf(io_isr,"\n{warn: push}");
 	     #endif
 	     return -1;
 	}
 	else {
-		q->buffer[ q->last ] = x;
-		q->last++;
-		if ( q->last >= q->len )
-			q->last = 0;
-
-		++(q->ct);
-
-          return 0;
+		q_push_o(q, x);
+		return 0;
 	}
 }
 
-int8_t q_push_o(queue_t *q, QUEUE_BASE_T x)
+int8_t q_push_o(queue_t *q, const void *x)
 {
-	q->buffer[ q->last ] = x;
+	memcpy(q_item(q, q->last), x, q->item_sz);
 	q->last++;
 	if ( q->last >= q->len )
 		q->last = 0;
 
-	if (!q_full(q))
+	if (q_full(q)) // the bottom was overwritten
+		q->first = q->last;
+	else
+		++(q->ct);
+	return 0;
+}
+
+int8_t q_put(queue_t *q, const void *x)
+{
+	if (q_full(q))
+		return -1;
+	q_put_o(q, x);
+	return 0;
+}
+
+int8_t q_put_o(queue_t *q, const void *x)
+{
+	q->first--;
+	if ( q->first >= q->len ) // if overflowed
+		q->first = q->len - 1;
+	memcpy(q_item(q, q->first), x, q->item_sz);
+
+	if (q_full(q)) // the top was overwritten
+		q->last = q->first;
+	else
 		++(q->ct);
-     return 0;
+	return 0;
 }
 
 bool q_empty(queue_t *q) {
@@ -1,8 +1,11 @@
 /*
- * queue.h
+ * queueG.h
+ * a queue of items of item_sz bytes, of any type. Items are copied in,
+ * and handed out as pointers into the buffer, valid until the next
+ * q_put/q_push.
 */
-#ifndef _QUEUE_H_
-#define _QUEUE_H_
+#ifndef _QUEUEG_H_
+#define _QUEUEG_H_
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -13,21 +16,24 @@
 typedef volatile struct {
 	QUEUE_BASE_PT buffer;	// buffer
 	QUEUE_INDEX_T first;	// position of first element
-	QUEUE_INDEX_T last;	// position of last element (should be eliminated)
+	QUEUE_INDEX_T last;	// position of last element +1
 	QUEUE_INDEX_T ct;	//
-	const QUEUE_INDEX_T len;	// length of the buffer
-	const QUEUE_INTEX_T item_sz;
+	const QUEUE_INDEX_T len;	// length of the buffer, in items
+	const QUEUE_INDEX_T item_sz;
 	//uint8_t flags;      // for when i need to tack something on.
 }  queue_t;
 
-#define Q_DEF(buff) { .buffer = (buff), .first = 0, .last = 0, .ct = 0, \
-	.buffer_sz = sizeof(buff) / sizeof( *(buff) ),\
+#define Q_DEF(buff) { .buffer = (QUEUE_BASE_PT)(buff), .first = 0, \
+	.last = 0, .ct = 0, \
+	.len = sizeof(buff) / sizeof( *(buff) ),\
 	.item_sz = sizeof( *(buff) ) }
 
-#define Q_DEF2(buff,len,sz) { .buffer = (buff), .first = 0, .last = 0, .ct = 0, \
-	.len = (len),\
+#define Q_DEF2(buff,n,sz) { .buffer = (QUEUE_BASE_PT)(buff), .first = 0, \
+	.last = 0, .ct = 0, \
+	.len = (n),\
 	.item_sz = (sz) }
 
+// pos counts from the bottom. NULL if there is no such item.
 QUEUE_BASE_PT q_peak(queue_t *q, QUEUE_INDEX_T pos);
 QUEUE_BASE_PT q_peak_fst(queue_t *q);
 
@@ -35,16 +41,15 @@ QUEUE_BASE_PT q_get(queue_t *q); //remove from bottom
 QUEUE_BASE_PT q_pop(queue_t *q); //remove from top
 
 // add to bottom.
-int8_t q_put(queue_t *q, QUEUE_BASE_T x);
-int8_t q_put_o(queue_t *q, QUEUE_BASE_T x); // overwrites old data on q full
+int8_t q_put(queue_t *q, const void *x);
+int8_t q_put_o(queue_t *q, const void *x); // overwrites the top on q full
 
 // add to top.
-int8_t q_push(queue_t *q, QUEUE_BASE_T x);
-int8_t q_push_o(queue_t *q, QUEUE_BASE_T x); // overwrites old data on q full
+int8_t q_push(queue_t *q, const void *x);
+int8_t q_push_o(queue_t *q, const void *x); // overwrites the bottom on q full
 
 void q_flush(queue_t *q);
 bool q_empty(queue_t *q);
 bool q_full(queue_t *q);
 
 #endif
-
@@ -1,6 +1,15 @@
-#include "circ_buf.h"
-
+/* Checks CIRC_CNT_TO_END and CIRC_SPACE_TO_END, which list_read,
+ * list_write and list_peek_span split their copies with, for every head
+ * and tail of uint8_t indexed rings up to 256 entries.
+ *
+ * gcc -std=gnu99 -Wall -o test_circ_buf test_circ_buf.c && ./test_circ_buf
+ * -v prints the macros for an 8 entry ring instead.
+ */
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "circ_buf.h"
 
 void print_info(uint8_t head, uint8_t tail, uint8_t size)
 {
@@ -13,14 +22,45 @@ void print_info(uint8_t head, uint8_t tail, uint8_t size)
 	printf("space:   %d\n", CIRC_SPACE(head, tail, size));
 }
 
+/* return: number of wrong results */
+static unsigned check(unsigned size)
+{
+	unsigned h, t, fails = 0;
+	for (h = 0; h < size; h++)
+	for (t = 0; t < size; t++) {
+		uint8_t head = h, tail = t;
+		unsigned cnt = (h - t + size) % size;
+		unsigned space = size - 1 - cnt;
+		unsigned cnt_end = cnt < size - t ? cnt : size - t;
+		unsigned space_end = space < size - h ? space : size - h;
+		if (CIRC_CNT_TO_END(head, tail, size) != cnt_end ||
+				CIRC_SPACE_TO_END(head, tail, size) != space_end) {
+			if (fails++ < 10)
+				printf("size %u head %u tail %u: cnt_to_end %u"
+					" space_to_end %u, want %u %u\n",
+					size, h, t,
+					(unsigned)CIRC_CNT_TO_END(head, tail, size),
+					(unsigned)CIRC_SPACE_TO_END(head, tail, size),
+					cnt_end, space_end);
+		}
+	}
+	return fails;
+}
+
 int main(int argc, char **argv)
 {
 	uint8_t head = 0, tail = 0, size = 8;
+	unsigned sz, fails = 0;
 
-	for(head = 0; head < size; head++) {
-		print_info(head, tail, size);
+	if (argc > 1 && !strcmp(argv[1], "-v")) {
+		for(head = 0; head < size; head++) {
+			print_info(head, tail, size);
+		}
+		return 0;
 	}
 
-
-	return 0;
+	for (sz = 1; sz <= 256; sz *= 2)
+		fails += check(sz);
+	printf("test_circ_buf: %s\n", fails ? "FAILED" : "ok");
+	return fails != 0;
 }
@@ -0,0 +1,106 @@
+/* Shared by the test_* programs of the Makefile here: checks, a repeatable
+ * rng, a reference model to run the containers against, and timing for
+ * their -b benchmarks. Host only.
+ */
+#ifndef TEST_DS_H_
+#define TEST_DS_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+static unsigned long test_fails;
+
+/* report and count a failed check, giving up after a screenful */
+#define CHECK(x) do {							\
+	if (!(x)) {							\
+		fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n",	\
+				__FILE__, __LINE__, __func__, #x);	\
+		if (++test_fails >= 20)					\
+			exit(1);					\
+	}								\
+} while (0)
+
+/* xorshift32, the same sequence every run */
+static uint32_t test_rand_state = 2463534242u;
+static inline uint32_t test_rand(void)
+{
+	uint32_t x = test_rand_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return test_rand_state = x;
+}
+
+/* The model: a deque as a plain array, v[0] the back (oldest in queue
+ * order, next for list_get/q_pop) and v[n - 1] the front (newest). */
+#define MODEL_MAX 1024
+struct model {
+	long v[MODEL_MAX];
+	unsigned n;
+};
+
+static inline void model_push_front(struct model *m, long x)
+{
+	m->v[m->n++] = x;
+}
+
+static inline void model_push_back(struct model *m, long x)
+{
+	memmove(m->v + 1, m->v, m->n * sizeof(*m->v));
+	m->v[0] = x;
+	m->n++;
+}
+
+static inline long model_pop_front(struct model *m)
+{
+	return m->v[--m->n];
+}
+
+static inline long model_pop_back(struct model *m)
+{
+	long x = m->v[0];
+	m->n--;
+	memmove(m->v, m->v + 1, m->n * sizeof(*m->v));
+	return x;
+}
+
+/* i counts from the front */
+static inline long model_peek(const struct model *m, unsigned i)
+{
+	return m->v[m->n - 1 - i];
+}
+
+static inline uint64_t test_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* keeps benchmark results live */
+static volatile long test_sink;
+
+/* time ops repetitions of body, print ns per op */
+#define BENCH(name, ops, body) do {					\
+	uint64_t _t0 = test_ns();					\
+	for (unsigned long _i = 0; _i < (ops); _i++) {			\
+		body;							\
+	}								\
+	printf("  %-32s %7.2f ns/op\n", (name),			\
+			(double)(test_ns() - _t0) / (ops));		\
+} while (0)
+
+/* return: exit status */
+static inline int test_done(const char *name)
+{
+	if (test_fails)
+		printf("%s: %lu checks failed\n", name, test_fails);
+	else
+		printf("%s: ok\n", name);
+	return test_fails != 0;
+}
+
+#endif
@@ -0,0 +1,324 @@
+/* Checks the CIRC_* macros of circ_buf.h and the lists of gcirc.h against
+ * test_ds.h's model.
+ *
+ * usage: test_gcirc [-b]
+ *
+ * The macros are checked for every head and tail of a range of sizes, with
+ * 8, 16 and 32 bit indexes. Each list (one per index width) then gets a
+ * long run of random operations, single element and bulk, checking every
+ * result and LIST_CT, empty and full after each. -b times them instead.
+ *
+ * Built with LIST_ATOMIC (test_gcirc_atomic) a producer thread also puts a
+ * count through a list, single and bulk, which the main thread checks
+ * comes out in order; -b then adds the cross-thread throughput.
+ */
+#include "test_ds.h"
+#include "gcirc.h"
+#ifdef LIST_ATOMIC
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define FUZZ_OPS 200000
+#define BENCH_OPS 20000000UL
+
+/*** CIRC_* ***/
+#define CHECK_CIRC(_index_t_, size) do {				\
+	unsigned _h, _t;						\
+	for (_h = 0; _h < (size); _h++)					\
+	for (_t = 0; _t < (size); _t++) {				\
+		_index_t_ head = _h, tail = _t;				\
+		unsigned cnt = (_h - _t + (size)) % (size);		\
+		unsigned space = (size) - 1 - cnt;			\
+		unsigned cnt_end = (size) - _t;				\
+		unsigned space_end = (size) - _h;			\
+		if (cnt_end > cnt)					\
+			cnt_end = cnt;					\
+		if (space_end > space)					\
+			space_end = space;				\
+		CHECK(CIRC_CNT(head, tail, size) == cnt);		\
+		CHECK(CIRC_SPACE(head, tail, size) == space);		\
+		CHECK(CIRC_CNT_TO_END(head, tail, size) == cnt_end);	\
+		CHECK(CIRC_SPACE_TO_END(head, tail, size) == space_end); \
+		CHECK(CIRC_FULL(head, tail, size) == !space);		\
+		CHECK(CIRC_NEXT(head, size) == (_h + 1) % (size));	\
+		CHECK(CIRC_NEXT_I(head, 3, size) == (_h + 3) % (size));	\
+		_index_t_ i = head;					\
+		CIRC_NEXT_EQ(i, size);					\
+		CHECK(i == (_h + 1) % (size));				\
+	}								\
+} while (0)
+
+static void check_circ(void)
+{
+	unsigned size;
+	for (size = 1; size <= 256; size *= 2)
+		CHECK_CIRC(uint8_t, size);
+	for (size = 1; size <= 1024; size *= 2)
+		CHECK_CIRC(uint16_t, size);
+	for (size = 1; size <= 512; size *= 2)
+		CHECK_CIRC(uint32_t, size);
+}
+
+/*** gcirc.h ***/
+LIST_DEFINE(u8,  static, , uint8_t, uint8_t)
+LIST_DEFINE(u16, static, , uint16_t, uint16_t)
+LIST_DEFINE(u32, static, , long, uint32_t)
+
+static uint8_t u8_buf[128];
+static uint16_t u16_buf[1024];
+static long u32_buf[64];
+
+/* a random number of elements for the bulk operations, past the
+ * capacity at times */
+#define FUZZ_LEN(l) (test_rand() % (2 * (l)->size))
+
+/* FUZZ_OPS random operations on l, checked against a model */
+#define FUZZ_LIST(_name_, _data_t_, _index_t_, l) do {			\
+	static struct model m;						\
+	static _data_t_ tmp[2 * MODEL_MAX];				\
+	unsigned cap = (l)->size - 1, op, i;				\
+	m.n = 0;							\
+	list_flush(_name_)(l);						\
+	for (op = 0; op < FUZZ_OPS; op++) {				\
+		_data_t_ x = test_rand();				\
+		_index_t_ n, len = FUZZ_LEN(l);				\
+		_data_t_ *span;						\
+		switch (test_rand() % 12) {				\
+		case 0:							\
+		case 1:							\
+			if (m.n == cap)					\
+				break;					\
+			list_pushf(_name_)(l, x);			\
+			model_push_front(&m, x);			\
+			break;						\
+		case 2:							\
+			if (m.n == cap)					\
+				break;					\
+			list_pushb(_name_)(l, x);			\
+			model_push_back(&m, x);				\
+			break;						\
+		case 3:							\
+			if (!m.n)					\
+				break;					\
+			CHECK(list_popf(_name_)(l) == model_pop_front(&m)); \
+			break;						\
+		case 4:							\
+			if (!m.n)					\
+				break;					\
+			CHECK(list_popb(_name_)(l) == model_pop_back(&m)); \
+			break;						\
+		case 5:							\
+			if (!m.n)					\
+				break;					\
+			i = test_rand() % m.n;				\
+			CHECK(list_peekf(_name_)(l) == model_peek(&m, 0)); \
+			CHECK(list_peekb(_name_)(l) == model_peek(&m, m.n - 1)); \
+			CHECK(list_peek(_name_)(l, i) == model_peek(&m, i)); \
+			CHECK(LIST_PEAKF(*(l)) == model_peek(&m, 0));	\
+			break;						\
+		case 6:							\
+		case 7:							\
+			for (i = 0; i < len; i++)			\
+				tmp[i] = test_rand();			\
+			n = list_write(_name_)(l, tmp, len);		\
+			CHECK(n == (len < cap - m.n ? len : cap - m.n)); \
+			for (i = 0; i < n; i++)				\
+				model_push_front(&m, tmp[i]);		\
+			break;						\
+		case 8:							\
+		case 9:							\
+			n = list_read(_name_)(l, tmp, len);		\
+			CHECK(n == (len < m.n ? len : m.n));		\
+			for (i = 0; i < n; i++)				\
+				CHECK(tmp[i] == model_pop_back(&m));	\
+			break;						\
+		case 10:						\
+			span = list_peek_span(_name_)(l, &n);		\
+			CHECK(n <= m.n && (n || !m.n));			\
+			CHECK(n == m.n || span + n == (l)->buffer + (l)->size); \
+			n = n ? test_rand() % (n + 1) : 0;		\
+			for (i = 0; i < n; i++)				\
+				CHECK(span[i] == model_pop_back(&m));	\
+			list_drop(_name_)(l, n);			\
+			break;						\
+		case 11:						\
+			if (test_rand() % 64)				\
+				break;					\
+			list_flush(_name_)(l);				\
+			m.n = 0;					\
+			break;						\
+		}							\
+		CHECK(LIST_CT(*(l)) == m.n);				\
+		CHECK(list_empty(_name_)(l) == !m.n);			\
+		CHECK(LIST_EMPTY(l) == !m.n);				\
+		CHECK(list_full(_name_)(l) == (m.n == cap));		\
+		CHECK(LIST_FULL(l) == (m.n == cap));			\
+		i = test_rand() % (cap + 1);				\
+		CHECK(list_valid_i(_name_)(l, i) == (i < m.n));		\
+		CHECK(LIST_VALID_I(l, i) == (i < m.n));			\
+	}								\
+} while (0)
+
+static void fuzz_lists(void)
+{
+	list_t(u8) l8 = LIST_INITIALIZER(u8_buf);
+	list_t(u16) l16 = LIST_INITIALIZER(u16_buf);
+	list_t(u32) l32 = LIST_INITIALIZER(u32_buf);
+	FUZZ_LIST(u8, uint8_t, uint8_t, &l8);
+	FUZZ_LIST(u16, uint16_t, uint16_t, &l16);
+	FUZZ_LIST(u32, long, uint32_t, &l32);
+}
+
+#ifdef LIST_ATOMIC
+/*** two threads ***/
+#define SPSC_OPS 2000000UL
+#define SPSC_BULK 61
+
+struct spsc {
+	list_t(u16) *l;
+	unsigned long n;
+	bool bulk;
+};
+
+/* puts 0 .. n - 1, mod 1 << 16, yielding while full */
+static void *spsc_producer(void *arg)
+{
+	struct spsc *s = arg;
+	uint16_t tmp[SPSC_BULK];
+	unsigned long i = 0;
+	uint16_t k, len;
+
+	while (i < s->n) {
+		if (!s->bulk) {
+			if (list_full(u16)(s->l))
+				sched_yield();
+			else
+				list_put(u16)(s->l, i++);
+			continue;
+		}
+		len = 1 + i % SPSC_BULK;
+		if (len > s->n - i)
+			len = s->n - i;
+		for (k = 0; k < len; k++)
+			tmp[k] = i + k;
+		len = list_write(u16)(s->l, tmp, len);
+		if (!len)
+			sched_yield();
+		i += len;
+	}
+	return NULL;
+}
+
+/* run a producer thread against this one as the consumer, list_read
+ * and list_peek_span taking turns when bulk. return: ns taken */
+static uint64_t spsc_run(list_t(u16) *l, unsigned long n, bool bulk)
+{
+	struct spsc s = { .l = l, .n = n, .bulk = bulk };
+	uint16_t tmp[SPSC_BULK], len, k, *span;
+	unsigned long i = 0;
+	pthread_t th;
+	uint64_t t0 = test_ns();
+
+	list_flush(u16)(l);
+	if (pthread_create(&th, NULL, spsc_producer, &s)) {
+		perror("pthread_create");
+		exit(1);
+	}
+	while (i < n) {
+		if (!bulk) {
+			if (list_empty(u16)(l)) {
+				sched_yield();
+				continue;
+			}
+			CHECK(list_get(u16)(l) == (uint16_t)i);
+			i++;
+			continue;
+		}
+		if (i & 1) {
+			len = list_read(u16)(l, tmp, 1 + i % SPSC_BULK);
+			for (k = 0; k < len; k++)
+				CHECK(tmp[k] == (uint16_t)(i + k));
+		} else {
+			span = list_peek_span(u16)(l, &len);
+			for (k = 0; k < len; k++)
+				CHECK(span[k] == (uint16_t)(i + k));
+			list_drop(u16)(l, len);
+		}
+		if (!len)
+			sched_yield();
+		i += len;
+	}
+	pthread_join(th, NULL);
+	CHECK(list_empty(u16)(l));
+	return test_ns() - t0;
+}
+
+static void spsc_lists(void)
+{
+	list_t(u16) l16 = LIST_INITIALIZER(u16_buf);
+	spsc_run(&l16, SPSC_OPS, false);
+	spsc_run(&l16, SPSC_OPS, true);
+}
+#endif
+
+/*** benchmarks ***/
+static void bench(void)
+{
+	static uint8_t tmp[32];
+	list_t(u8) l8 = LIST_INITIALIZER(u8_buf);
+	list_t(u16) l16 = LIST_INITIALIZER(u16_buf);
+	uint8_t n;
+
+	printf("gcirc.h, u8 = 128 x uint8_t, u16 = 1024 x uint16_t:\n");
+	BENCH("u8 put+get", BENCH_OPS, {
+		list_put(u8)(&l8, _i);
+		test_sink += list_get(u8)(&l8);
+	});
+	BENCH("u16 put+get", BENCH_OPS, {
+		list_put(u16)(&l16, _i);
+		test_sink += list_get(u16)(&l16);
+	});
+	BENCH("u8 push+pop", BENCH_OPS, {
+		list_push(u8)(&l8, _i);
+		test_sink += list_pop(u8)(&l8);
+	});
+	BENCH("u8 32 x (put+get)", BENCH_OPS / 32, {
+		for (n = 0; n < sizeof(tmp); n++)
+			list_put(u8)(&l8, tmp[n]);
+		for (n = 0; n < sizeof(tmp); n++)
+			tmp[n] = list_get(u8)(&l8);
+	});
+	BENCH("u8 write+read 32", BENCH_OPS / 32, {
+		list_write(u8)(&l8, tmp, sizeof(tmp));
+		test_sink += list_read(u8)(&l8, tmp, sizeof(tmp));
+	});
+	BENCH("u8 write+peek_span+drop 32", BENCH_OPS / 32, {
+		list_write(u8)(&l8, tmp, sizeof(tmp));
+		test_sink += *list_peek_span(u8)(&l8, &n);
+		list_drop(u8)(&l8, n);
+	});
+#ifdef LIST_ATOMIC
+	printf("  %-32s %7.2f ns/op\n", "u16 put | get, two threads",
+			(double)spsc_run(&l16, BENCH_OPS / 4, false) /
+			(BENCH_OPS / 4));
+	printf("  %-32s %7.2f ns/op\n", "u16 write | read, two threads",
+			(double)spsc_run(&l16, BENCH_OPS, true) / BENCH_OPS);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+	check_circ();
+	fuzz_lists();
+#ifdef LIST_ATOMIC
+	spsc_lists();
+	return test_done("test_gcirc_atomic");
+#else
+	return test_done("test_gcirc");
+#endif
+}
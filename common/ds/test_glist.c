@@ -0,0 +1,131 @@
+/* Checks the lists of glist.h against test_ds.h's model.
+ *
+ * usage: test_glist [-b]
+ *
+ * glist.h keeps a count, so sizes need not be powers of 2. One list per
+ * index width, and one of an odd size, each get a long run of random
+ * operations, checking every result and LIST_CT, empty and full after
+ * each. -b times them instead.
+ */
+#include "test_ds.h"
+#include "glist.h"
+
+#define FUZZ_OPS 200000
+#define BENCH_OPS 20000000UL
+
+LIST_DEFINE(u8,  static, , uint8_t, uint8_t)
+LIST_DEFINE(u16, static, , uint16_t, uint16_t)
+LIST_DEFINE(ptr, static, , void *, uint8_t)
+
+static uint8_t u8_buf[255];
+static uint8_t odd_buf[7];
+static uint16_t u16_buf[1000];
+static void *ptr_buf[16];
+
+/* FUZZ_OPS random operations on l, checked against a model */
+#define FUZZ_LIST(_name_, _data_t_, l) do {				\
+	static struct model m;						\
+	unsigned cap = (l)->sz, op, i;					\
+	m.n = 0;							\
+	list_flush(_name_)(l);						\
+	for (op = 0; op < FUZZ_OPS; op++) {				\
+		_data_t_ x = (_data_t_)(uintptr_t)test_rand();		\
+		switch (test_rand() % 9) {				\
+		case 0:							\
+		case 1:							\
+			if (m.n == cap)					\
+				break;					\
+			list_pushf(_name_)(l, x);			\
+			model_push_front(&m, (long)x);			\
+			break;						\
+		case 2:							\
+		case 3:							\
+			if (m.n == cap)					\
+				break;					\
+			list_pushb(_name_)(l, x);			\
+			model_push_back(&m, (long)x);			\
+			break;						\
+		case 4:							\
+			/* overwrites the back when full */		\
+			if (m.n == cap)					\
+				model_pop_back(&m);			\
+			list_pushfo(_name_)(l, x);			\
+			model_push_front(&m, (long)x);			\
+			break;						\
+		case 5:							\
+			if (!m.n)					\
+				break;					\
+			CHECK((long)list_popf(_name_)(l) == model_pop_front(&m)); \
+			break;						\
+		case 6:							\
+			if (!m.n)					\
+				break;					\
+			CHECK((long)list_popb(_name_)(l) == model_pop_back(&m)); \
+			break;						\
+		case 7:							\
+			if (!m.n)					\
+				break;					\
+			i = test_rand() % m.n;				\
+			CHECK((long)list_peekf(_name_)(l) == model_peek(&m, 0)); \
+			CHECK((long)list_peekb(_name_)(l) == model_peek(&m, m.n - 1)); \
+			CHECK((long)list_peek(_name_)(l, i) == model_peek(&m, i)); \
+			CHECK((long)LIST_PEAKF(*(l)) == model_peek(&m, 0)); \
+			break;						\
+		case 8:							\
+			if (test_rand() % 64)				\
+				break;					\
+			list_flush(_name_)(l);				\
+			m.n = 0;					\
+			break;						\
+		}							\
+		CHECK(LIST_CT(*(l)) == m.n);				\
+		CHECK(list_empty(_name_)(l) == !m.n);			\
+		CHECK(LIST_EMPTY(l) == !m.n);				\
+		CHECK(list_full(_name_)(l) == (m.n == cap));		\
+		CHECK(LIST_FULL(l) == (m.n == cap));			\
+		i = test_rand() % (cap + 1);				\
+		CHECK(list_valid_i(_name_)(l, i) == (i < m.n));		\
+	}								\
+} while (0)
+
+static void fuzz_lists(void)
+{
+	list_t(u8) l8 = LIST_INITIALIZER(u8_buf);
+	list_t(u8) odd = LIST_INITIALIZER(odd_buf);
+	list_t(u16) l16 = LIST_INITIALIZER(u16_buf);
+	list_t(ptr) p = LIST_INITIALIZER(ptr_buf);
+	FUZZ_LIST(u8, uint8_t, &l8);
+	FUZZ_LIST(u8, uint8_t, &odd);
+	FUZZ_LIST(u16, uint16_t, &l16);
+	FUZZ_LIST(ptr, void *, &p);
+}
+
+static void bench(void)
+{
+	list_t(u8) l8 = LIST_INITIALIZER(u8_buf);
+	list_t(u16) l16 = LIST_INITIALIZER(u16_buf);
+
+	printf("glist.h, u8 = 255 x uint8_t, u16 = 1000 x uint16_t:\n");
+	BENCH("u8 put+get", BENCH_OPS, {
+		list_put(u8)(&l8, _i);
+		test_sink += list_get(u8)(&l8);
+	});
+	BENCH("u16 put+get", BENCH_OPS, {
+		list_put(u16)(&l16, _i);
+		test_sink += list_get(u16)(&l16);
+	});
+	BENCH("u8 push+pop", BENCH_OPS, {
+		list_push(u8)(&l8, _i);
+		test_sink += list_pop(u8)(&l8);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+	fuzz_lists();
+	return test_done("test_glist");
+}
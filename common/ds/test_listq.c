@@ -0,0 +1,175 @@
+/* Checks list.c and queue.c against test_ds.h's model.
+ *
+ * usage: test_listq [-b]
+ *
+ * Each container gets a long run of random operations, of an odd and of a
+ * full 255 entry size, checking every result and the count, empty and full
+ * after each. Operations which would fail (and print an error) are not
+ * tried. -b times them instead.
+ */
+#include "test_ds.h"
+#include "list.h"
+#include "queue.h"
+
+#define FUZZ_OPS 200000
+#define BENCH_OPS 20000000UL
+
+/*** list.c ***/
+static void fuzz_list(list_t *l)
+{
+	static struct model m;
+	unsigned cap = l->sz, op, i;
+	m.n = 0;
+	list_flush(l);
+	for (op = 0; op < FUZZ_OPS; op++) {
+		list_base_t x = test_rand();
+		switch (test_rand() % 10) {
+		case 0:
+		case 1:
+			if (m.n == cap)
+				break;
+			CHECK(list_push_front(l, x) == 0);
+			model_push_front(&m, x);
+			break;
+		case 2:
+		case 3:
+			if (m.n == cap)
+				break;
+			CHECK(list_push_back(l, x) == 0);
+			model_push_back(&m, x);
+			break;
+		case 4:
+			/* overwrites the back when full */
+			if (m.n == cap)
+				model_pop_back(&m);
+			list_push_front_o(l, x);
+			model_push_front(&m, x);
+			break;
+		case 5:
+			/* overwrites the front when full */
+			if (m.n == cap)
+				model_pop_front(&m);
+			list_push_back_o(l, x);
+			model_push_back(&m, x);
+			break;
+		case 6:
+			if (!m.n)
+				break;
+			CHECK(list_pop_front(l) == model_pop_front(&m));
+			break;
+		case 7:
+			if (!m.n)
+				break;
+			CHECK(list_pop_back(l) == model_pop_back(&m));
+			break;
+		case 8:
+			if (!m.n)
+				break;
+			i = test_rand() % m.n;
+			CHECK(list_peek_front(l) == model_peek(&m, 0));
+			CHECK(list_peek_back(l) == model_peek(&m, m.n - 1));
+			CHECK(list_peek(l, i) == model_peek(&m, i));
+			break;
+		case 9:
+			if (test_rand() % 64)
+				break;
+			list_flush(l);
+			m.n = 0;
+			break;
+		}
+		CHECK(l->ct == m.n);
+		CHECK(list_empty(l) == !m.n);
+		CHECK(list_full(l) == (m.n == cap));
+		i = test_rand() % (cap + 1);
+		CHECK(list_valid_index(l, i) == (i < m.n));
+	}
+}
+
+/*** queue.c ***/
+static void fuzz_queue(queue_t *q)
+{
+	static struct model m;
+	unsigned cap = q->sz, op;
+	m.n = 0;
+	q_flush(q);
+	for (op = 0; op < FUZZ_OPS; op++) {
+		QUEUE_BASE_T x = test_rand();
+		switch (test_rand() % 7) {
+		case 0:
+		case 1:
+			if (m.n == cap)
+				break;
+			CHECK(q_push(q, x) == 0);
+			model_push_front(&m, x);
+			break;
+		case 2:
+			/* overwrites the oldest when full */
+			if (m.n == cap)
+				model_pop_back(&m);
+			CHECK(q_push_o(q, x) == 0);
+			model_push_front(&m, x);
+			break;
+		case 3:
+		case 4:
+			if (!m.n)
+				break;
+			CHECK(q_pop(q) == model_pop_back(&m));
+			break;
+		case 5:
+			if (!m.n)
+				break;
+			CHECK(q_remove(q) == model_pop_front(&m));
+			break;
+		case 6:
+			if (test_rand() % 64)
+				break;
+			q_flush(q);
+			m.n = 0;
+			break;
+		}
+		CHECK(q->ct == m.n);
+		CHECK(q_empty(q) == !m.n);
+		CHECK(q_full(q) == (m.n == cap));
+	}
+}
+
+static list_base_t list_buf[255], list_odd_buf[7];
+static QUEUE_BASE_T q_buf[255], q_odd_buf[7];
+
+static void bench(void)
+{
+	list_t l = LIST_INITIALIZER(list_buf);
+	queue_t q = Q_INIT(q_buf);
+
+	printf("list.c, queue.c, 255 x char:\n");
+	BENCH("list push_back+pop_front", BENCH_OPS, {
+		list_push_back(&l, _i);
+		test_sink += list_pop_front(&l);
+	});
+	BENCH("list push_front+pop_front", BENCH_OPS, {
+		list_push_front(&l, _i);
+		test_sink += list_pop_front(&l);
+	});
+	BENCH("queue push+pop", BENCH_OPS, {
+		q_push(&q, _i);
+		test_sink += q_pop(&q);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+
+	list_t l = LIST_INITIALIZER(list_buf);
+	list_t l_odd = LIST_INITIALIZER(list_odd_buf);
+	queue_t q = Q_INIT(q_buf);
+	queue_t q_odd = Q_INIT(q_odd_buf);
+	fuzz_list(&l);
+	fuzz_list(&l_odd);
+	fuzz_queue(&q);
+	fuzz_queue(&q_odd);
+	return test_done("test_listq");
+}
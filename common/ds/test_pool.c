@@ -0,0 +1,165 @@
+/* Checks pool.h against a model of the blocks held.
+ *
+ * usage: test_pool [-b]
+ *
+ * Pools of 5 x 3 byte and of 255 x 32 byte blocks get a long run of
+ * random alloc, ref and unref. Each block held is filled with a tag which
+ * must survive until its last unref, and the references, used and peak
+ * are checked after each operation. Then a block is given a 256th
+ * reference and a free block is unreferenced, which must trip POOL_ASSERT
+ * and leave the pool as it was. -b times them instead.
+ */
+#include "test_ds.h"
+
+/* count pool.h's complaints instead of aborting, to check them */
+static unsigned long pool_asserts;
+#define POOL_ASSERT(x) ((x) ? (void)0 : (void)pool_asserts++)
+#include "pool.h"
+
+#define FUZZ_OPS 200000
+#define BENCH_OPS 20000000UL
+
+POOL_DECLARE(odd, 5, 3)
+POOL_DEFINE(odd, 5, 3)
+POOL_DECLARE(big, 255, 32)
+POOL_DEFINE(big, 255, 32)
+POOL_DECLARE(two, 2, 4)
+POOL_DEFINE(two, 2, 4)
+
+/* a block held by the model */
+struct held {
+	uint8_t *p;
+	unsigned refs;
+	uint8_t tag;
+};
+
+static bool block_is(const uint8_t *p, uint8_t tag, unsigned sz)
+{
+	unsigned i;
+	for (i = 0; i < sz; i++)
+		if (p[i] != (uint8_t)(tag + i))
+			return false;
+	return true;
+}
+
+/* FUZZ_OPS random operations on pool _name_, checked against a model */
+#define FUZZ_POOL(_name_) do {						\
+	static struct held h[POOL_CT(_name_)];				\
+	unsigned n = 0, peak = 0, op, i, j;				\
+	uint8_t *base = pool_v(_name_).data[0];				\
+	for (op = 0; op < FUZZ_OPS; op++) {				\
+		uint8_t *p;						\
+		switch (test_rand() % 4) {				\
+		case 0:							\
+		case 1:							\
+			p = pool_alloc(_name_)();			\
+			if (n == POOL_CT(_name_)) {			\
+				CHECK(p == NULL);			\
+				break;					\
+			}						\
+			CHECK(p != NULL);				\
+			if (!p)						\
+				break;					\
+			CHECK(p >= base && (p - base) %		\
+					POOL_SZ(_name_) == 0 &&		\
+					p < base + POOL_CT(_name_) *	\
+					POOL_SZ(_name_));		\
+			for (j = 0; j < n; j++)				\
+				CHECK(h[j].p != p);			\
+			h[n].p = p;					\
+			h[n].refs = 1;					\
+			h[n].tag = test_rand();				\
+			for (j = 0; j < POOL_SZ(_name_); j++)		\
+				p[j] = h[n].tag + j;			\
+			if (++n > peak)					\
+				peak = n;				\
+			break;						\
+		case 2:							\
+			if (!n)						\
+				break;					\
+			i = test_rand() % n;				\
+			if (h[i].refs == UINT8_MAX)			\
+				break;					\
+			CHECK(pool_ref(_name_)(h[i].p) == h[i].p);	\
+			h[i].refs++;					\
+			break;						\
+		case 3:							\
+			if (!n)						\
+				break;					\
+			i = test_rand() % n;				\
+			CHECK(block_is(h[i].p, h[i].tag, POOL_SZ(_name_))); \
+			pool_unref(_name_)(h[i].p);			\
+			if (!--h[i].refs)				\
+				h[i] = h[--n];				\
+			break;						\
+		}							\
+		CHECK(pool_used(_name_)() == n);			\
+		CHECK(pool_peak(_name_)() == peak);			\
+		if (n) {						\
+			i = test_rand() % n;				\
+			CHECK(pool_refs(_name_)(h[i].p) == h[i].refs);	\
+		}							\
+	}								\
+} while (0)
+
+/* the misuse POOL_ASSERT catches, on pool two */
+static void misuse(void)
+{
+	uint8_t *p = pool_alloc(two)(), *q;
+	unsigned i;
+
+	CHECK(pool_used(two)() == 1);
+	for (i = 1; i < UINT8_MAX; i++)
+		pool_ref(two)(p);
+	CHECK(pool_refs(two)(p) == UINT8_MAX && !pool_asserts);
+	pool_ref(two)(p);
+	CHECK(pool_refs(two)(p) == UINT8_MAX && pool_asserts == 1);
+
+	for (i = 0; i < UINT8_MAX; i++)
+		pool_unref(two)(p);
+	CHECK(pool_used(two)() == 0 && pool_asserts == 1);
+	pool_unref(two)(p);
+	pool_ref(two)(p);
+	CHECK(pool_refs(two)(p) == 0 && pool_asserts == 3);
+	CHECK(pool_used(two)() == 0);
+
+	/* the free stack holds p once: the next two blocks differ */
+	p = pool_alloc(two)();
+	q = pool_alloc(two)();
+	CHECK(p && q && p != q && pool_used(two)() == 2);
+	pool_unref(two)(p);
+	pool_unref(two)(q);
+	CHECK(pool_used(two)() == 0 && pool_asserts == 3);
+}
+
+static void bench(void)
+{
+	uint8_t *p;
+
+	printf("pool.h, 255 x 32 bytes:\n");
+	BENCH("alloc+unref", BENCH_OPS, {
+		p = pool_alloc(big)();
+		p[0] = _i;
+		test_sink += p[0];
+		pool_unref(big)(p);
+	});
+	BENCH("alloc+ref+unref+unref", BENCH_OPS, {
+		p = pool_ref(big)(pool_alloc(big)());
+		pool_unref(big)(p);
+		test_sink += p[0];
+		pool_unref(big)(p);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+	FUZZ_POOL(odd);
+	FUZZ_POOL(big);
+	CHECK(!pool_asserts);
+	misuse();
+	return test_done("test_pool");
+}
@@ -0,0 +1,132 @@
+/* Checks queueG.c against test_ds.h's model.
+ *
+ * usage: test_queueG [-b]
+ *
+ * A queue of 3 byte items gets a long run of random operations at both
+ * ends, checking every item and the count, empty and full after each.
+ * -b times it instead.
+ */
+#include "test_ds.h"
+#include "queueG.h"
+
+#define FUZZ_OPS 200000
+#define BENCH_OPS 20000000UL
+
+/* an item, filled from the model's value */
+struct item {
+	uint8_t b[3];
+};
+
+static void item_set(struct item *it, long x)
+{
+	it->b[0] = x;
+	it->b[1] = x >> 8;
+	it->b[2] = ~x;
+}
+
+static bool item_is(const char *p, long x)
+{
+	struct item it;
+	item_set(&it, x);
+	return p && !memcmp(p, &it, sizeof(it));
+}
+
+static void fuzz_queue(queue_t *q)
+{
+	static struct model m;
+	unsigned cap = q->len, op, i;
+	struct item it;
+	m.n = 0;
+	q_flush(q);
+	for (op = 0; op < FUZZ_OPS; op++) {
+		long x = test_rand() & 0xffff;
+		item_set(&it, x);
+		switch (test_rand() % 10) {
+		case 0:
+		case 1:
+			CHECK(q_push(q, &it) == (m.n == cap ? -1 : 0));
+			if (m.n < cap)
+				model_push_front(&m, x);
+			break;
+		case 2:
+			CHECK(q_put(q, &it) == (m.n == cap ? -1 : 0));
+			if (m.n < cap)
+				model_push_back(&m, x);
+			break;
+		case 3:
+			if (m.n == cap)
+				model_pop_back(&m);
+			q_push_o(q, &it);
+			model_push_front(&m, x);
+			break;
+		case 4:
+			if (m.n == cap)
+				model_pop_front(&m);
+			q_put_o(q, &it);
+			model_push_back(&m, x);
+			break;
+		case 5:
+		case 6:
+			if (!m.n)
+				CHECK(q_get(q) == NULL);
+			else
+				CHECK(item_is(q_get(q), model_pop_back(&m)));
+			break;
+		case 7:
+			if (!m.n)
+				CHECK(q_pop(q) == NULL);
+			else
+				CHECK(item_is(q_pop(q), model_pop_front(&m)));
+			break;
+		case 8:
+			i = test_rand() % (cap + 1);
+			if (i < m.n)
+				CHECK(item_is(q_peak(q, i),
+						model_peek(&m, m.n - 1 - i)));
+			else
+				CHECK(q_peak(q, i) == NULL);
+			if (m.n)
+				CHECK(item_is(q_peak_fst(q),
+						model_peek(&m, m.n - 1)));
+			break;
+		case 9:
+			if (test_rand() % 64)
+				break;
+			q_flush(q);
+			m.n = 0;
+			break;
+		}
+		CHECK(q->ct == m.n);
+		CHECK(q_empty(q) == !m.n);
+		CHECK(q_full(q) == (m.n == cap));
+	}
+}
+
+static struct item q_buf[255], q_odd_buf[7];
+
+static void bench(void)
+{
+	queue_t q = Q_DEF(q_buf);
+	struct item it = { { 1, 2, 3 } };
+
+	printf("queueG.c, 255 x 3 bytes:\n");
+	BENCH("push+get", BENCH_OPS, {
+		it.b[0] = _i;
+		q_push(&q, &it);
+		test_sink += *q_get(&q);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+
+	queue_t q = Q_DEF(q_buf);
+	queue_t q_odd = Q_DEF2(q_odd_buf, 7, sizeof(struct item));
+	fuzz_queue(&q);
+	fuzz_queue(&q_odd);
+	return test_done("test_queueG");
+}
@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_async.h"
+#include "chan.h"
+#include "link.h"
+#include "proto.h"
+#include "baud.h"
+
+enum baud_state {
+	BAUD_IDLE,   /* running at `ubrr`, nothing in progress */
+	BAUD_SWITCH, /* answer queued, switch to `ubrr` once it is out */
+	BAUD_TRIAL,  /* at `ubrr`, waiting for the host to show up */
+};
+
+static struct {
+	uint8_t state;
+	bool u2x;
+	uint16_t ubrr;
+	uint16_t timeout;
+	uint16_t since; /* start of BAUD_TRIAL */
+} baud;
+
+void baud_init(uint16_t timeout)
+{
+	baud.state = BAUD_IDLE;
+	baud.ubrr = FRAME_UBRR_DEFAULT;
+	baud.u2x = FRAME_U2X_DEFAULT;
+	baud.timeout = timeout;
+}
+
+static bool baud_answer(uint16_t ubrr, bool u2x)
+{
+	const uint8_t xid[BAUD_XID_LEN] = {
+		LINK_U_XID | LINK_PF,
+		(uint8_t)(ubrr >> 8), (uint8_t)ubrr,
+		u2x ? BAUD_F_U2X : 0,
+	};
+	return chan_send(CHAN_LINK, xid, sizeof(xid));
+}
+
+bool baud_recv(const struct frame_seg *seg)
+{
+	uint8_t xid[BAUD_XID_LEN];
+	frame_len_t len = 0, i;
+	uint8_t s;
+
+	for (s = 0; s < 2; s++)
+		for (i = 0; i < seg[s].len; i++, len++)
+			if (len < sizeof(xid))
+				xid[len] = seg[s].data[i];
+
+	if (!len || (xid[0] & ~LINK_PF) != LINK_U_XID) {
+		/* any good frame shows the host made it to the new speed */
+		if (len && baud.state == BAUD_TRIAL)
+			baud.state = BAUD_IDLE;
+		return false;
+	}
+
+	if (len != sizeof(xid))
+		return true;
+
+	uint16_t ubrr = ((uint16_t)xid[1] << 8) | xid[2];
+	bool u2x = xid[3] & BAUD_F_U2X;
+
+	if (baud.state == BAUD_TRIAL && ubrr == baud.ubrr && u2x == baud.u2x) {
+		/* the confirmation */
+		baud.state = BAUD_IDLE;
+		baud_answer(ubrr, u2x);
+		return true;
+	}
+
+	/* busy switching to the last proposal */
+	if (baud.state == BAUD_SWITCH)
+		return true;
+
+	if (ubrr > BAUD_UBRR_MAX) {
+		baud_answer(baud.ubrr, baud.u2x);
+		return true;
+	}
+
+	/* without an answer the host won't switch, so neither do we */
+	if (baud_answer(ubrr, u2x)) {
+		baud.ubrr = ubrr;
+		baud.u2x = u2x;
+		baud.state = BAUD_SWITCH;
+	}
+	return true;
+}
+
+void baud_poll(uint16_t now)
+{
+	switch (baud.state) {
+	case BAUD_SWITCH:
+		if (!frame_tx_drained())
+			break;
+		frame_set_ubrr(baud.ubrr, baud.u2x);
+		baud.since = now;
+		baud.state = BAUD_TRIAL;
+		break;
+	case BAUD_TRIAL:
+		if ((uint16_t)(now - baud.since) < baud.timeout)
+			break;
+		baud.ubrr = FRAME_UBRR_DEFAULT;
+		baud.u2x = FRAME_U2X_DEFAULT;
+		frame_set_ubrr(baud.ubrr, baud.u2x);
+		baud.state = BAUD_IDLE;
+		break;
+	}
+}
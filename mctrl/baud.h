@@ -0,0 +1,35 @@
+#ifndef BAUD_H_
+#define BAUD_H_ 1
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_gen.h"
+
+/* Run time speed negotiation for the host link.
+ *
+ * The host proposes a UBRR/U2X setting in an XID frame (see proto.h). The
+ * board answers with the setting it is going to switch to, or with its
+ * current one if the proposal is unusable. Once the answer has left the
+ * usart the board switches, and the host does the same when it gets the
+ * answer. The host then repeats the XID at the new speed as a confirmation,
+ * which is answered the same way.
+ *
+ * If no frame arrives at the new speed within `timeout` ticks the board
+ * goes back to the default (FRAME_BAUD) setting, as does the host when it
+ * gets no answer. The host side is in pc/serial.c.
+ */
+
+/* timeout: in units of the `now` passed to baud_poll() */
+void baud_init(uint16_t timeout);
+
+/* seg: a frame received on CHAN_LINK, as passed to a chan_recv_fn.
+ * return: true if it was a speed negotiation frame, which has been handled
+ *         and should be dropped by the caller.
+ */
+bool baud_recv(const struct frame_seg *seg);
+
+/* switch speed once the answer is out, and fall back on timeout. Call
+ * regularly, `now` is a free running tick count (wraps). */
+void baud_poll(uint16_t now);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_async.h"
+#include "proto.h"
+#include "chan.h"
+
+static chan_recv_fn chan_recv[CHAN_COUNT];
+static chan_fast_fn chan_fast[CHAN_FAST_OPS];
+static uint8_t drops;
+
+void chan_set_recv(uint8_t chan, chan_recv_fn fn)
+{
+	if (chan < CHAN_COUNT)
+		chan_recv[chan] = fn;
+}
+
+void chan_set_fast(uint8_t op, chan_fast_fn fn)
+{
+	if (op < CHAN_FAST_OPS)
+		chan_fast[op] = fn;
+}
+
+/* the frame_fast_fn, in the RX ISR */
+static bool chan_fast_frame(const uint8_t *data, uint8_t len)
+{
+	chan_fast_fn fn;
+	if (len != 2 || data[0] != CHAN_FAST || data[1] >= CHAN_FAST_OPS)
+		return false;
+	fn = chan_fast[data[1]];
+	if (!fn)
+		return false;
+	fn();
+	return true;
+}
+
+/* fast frames the RX ISR didn't take */
+static void chan_fast_recv(uint8_t chan, const struct frame_seg *seg)
+{
+	uint8_t op = seg[0].data[0];
+	if (seg[0].len + seg[1].len == 1 && op < CHAN_FAST_OPS && chan_fast[op])
+		chan_fast[op]();
+	else
+		drops++;
+}
+
+bool chan_sendv(uint8_t chan, const struct frame_seg *seg, uint8_t nseg)
+{
+	struct frame_seg s[1 + CHAN_SEG_MAX];
+	uint8_t i;
+
+	if (nseg > CHAN_SEG_MAX)
+		return false;
+
+	s[0].data = &chan;
+	s[0].len = 1;
+	for (i = 0; i < nseg; i++)
+		s[1 + i] = seg[i];
+	return frame_sendv(s, 1 + nseg);
+}
+
+bool chan_send(uint8_t chan, const void *data, frame_len_t len)
+{
+	struct frame_seg seg = { data, len };
+	return chan_sendv(chan, &seg, 1);
+}
+
+void chan_start(uint8_t chan)
+{
+	frame_start();
+	frame_append_u8(chan);
+}
+
+bool chan_poll(void)
+{
+	struct frame_seg seg[2];
+	if (!frame_recv_peek(seg))
+		return false;
+
+	uint8_t chan = seg[0].data[0];
+	seg[0].data++;
+	seg[0].len--;
+	if (!seg[0].len) {
+		seg[0] = seg[1];
+		seg[1].len = 0;
+	}
+
+	if (chan < CHAN_COUNT && chan_recv[chan] && seg[0].len)
+		chan_recv[chan](chan, seg);
+	else
+		drops++;
+
+	frame_recv_commit();
+	return true;
+}
+
+uint8_t chan_drops(void)
+{
+	return drops;
+}
+
+/*** Console ***/
+static char line[CHAN_CONSOLE_LINE];
+static uint8_t line_len;
+
+void chan_console_flush(void)
+{
+	if (line_len) {
+		chan_send(CHAN_CONSOLE, line, line_len);
+		line_len = 0;
+	}
+}
+
+#if defined(AVR)
+static int chan_console_putchar(char c, FILE *stream)
+{
+	line[line_len++] = c;
+	if (c == '\n' || line_len == sizeof(line))
+		chan_console_flush();
+	return 0;
+}
+
+FILE chan_console =
+	FDEV_SETUP_STREAM(chan_console_putchar, NULL, _FDEV_SETUP_WRITE);
+#endif
+
+void chan_init(void)
+{
+	uint8_t i;
+	for (i = 0; i < CHAN_COUNT; i++)
+		chan_recv[i] = NULL;
+	for (i = 0; i < CHAN_FAST_OPS; i++)
+		chan_fast[i] = NULL;
+	chan_recv[CHAN_FAST] = chan_fast_recv;
+	frame_set_fast(chan_fast_frame);
+	drops = 0;
+	line_len = 0;
+
+#if defined(AVR) && defined(DEBUG)
+	stdout = stderr = &chan_console;
+#endif
+}
@@ -0,0 +1,77 @@
+#ifndef CHAN_H_
+#define CHAN_H_ 1
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_gen.h"
+#include "proto.h"
+
+/* Virtual channels over the host link.
+ *
+ * Every frame starts with a channel byte (see proto.h) naming the stream it
+ * belongs to, so the console, RPC, telemetry and bulk transfers share the
+ * link without one's bytes ending up in another. Each channel has its own
+ * receive callback. Frames for channels without one are dropped.
+ *
+ * The host end is pc/chanmux.c.
+ */
+
+/* longest console line sent in one frame */
+#ifndef CHAN_CONSOLE_LINE
+# define CHAN_CONSOLE_LINE 24
+#endif
+
+/* max nseg of chan_sendv() */
+#define CHAN_SEG_MAX 3
+
+/* number of CHAN_FAST ops chan_set_fast() takes */
+#define CHAN_FAST_OPS 4
+
+/* chan: the channel the frame arrived on.
+ * seg: its payload, without the channel byte, as from frame_recv_peek().
+ *      Only valid for the duration of the call.
+ */
+typedef void (*chan_recv_fn)(uint8_t chan, const struct frame_seg *seg);
+
+/* drop all callbacks, and with DEBUG make chan_console stdout and stderr.
+ * Call with interrupts off. */
+void chan_init(void);
+
+void chan_set_recv(uint8_t chan, chan_recv_fn fn);
+
+/* run on a CHAN_FAST frame of op: from the RX ISR with FRAME_FAST, from
+ * chan_poll() otherwise. A few register writes at most. Set it with
+ * interrupts off. */
+typedef void (*chan_fast_fn)(void);
+void chan_set_fast(uint8_t op, chan_fast_fn fn);
+
+/* send a frame on chan.
+ * return: as frame_send.
+ */
+bool chan_send(uint8_t chan, const void *data, frame_len_t len);
+bool chan_sendv(uint8_t chan, const struct frame_seg *seg, uint8_t nseg);
+
+/* frame_start() a frame on chan, to be built with frame_append_*() and
+ * sent with frame_done(). */
+void chan_start(uint8_t chan);
+
+/* hand the next received frame to its channel's callback.
+ * return: true if there was a frame.
+ */
+bool chan_poll(void);
+
+/* frames dropped for being empty, on a channel without a callback, or for
+ * a CHAN_FAST op without one */
+uint8_t chan_drops(void);
+
+#if defined(AVR)
+/* text out on CHAN_CONSOLE, a frame per line (or per CHAN_CONSOLE_LINE
+ * bytes). It never waits: lines which don't fit in the tx ring are lost. */
+extern FILE chan_console;
+#endif
+
+/* send whatever is left of the current console line */
+void chan_console_flush(void);
+
+#endif
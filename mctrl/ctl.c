@@ -0,0 +1,188 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+
+#include "frame_async.h"
+#include "chan.h"
+#include "rpc.h"
+#include "tick.h"
+#include "pid.h"
+#include "motor_shb.h"
+#include "ctl.h"
+
+#define CTL_MOTORS ARRAY_SIZE(mshb_d)
+
+static struct pid pid[CTL_MOTORS];
+/* written by ctl_stop() from the RX ISR, so changed atomically elsewhere */
+static uint8_t enabled;
+
+/* a heartbeat arrived since ctl_poll() last looked, and the time of the
+ * last one it saw */
+static volatile bool hb_beat;
+static bool hb_armed;
+static uint32_t hb_last;
+
+/* FAST_STOP, from the RX ISR */
+static void ctl_stop(void)
+{
+	uint8_t i;
+	for (i = 0; i < CTL_MOTORS; i++) {
+		mshb_disable(i);
+		mshb_set(i, 0);
+	}
+	enabled = 0;
+}
+
+static void ctl_heartbeat(void)
+{
+	hb_beat = true;
+}
+
+void ctl_poll(uint32_t now)
+{
+	if (hb_beat) {
+		hb_beat = false;
+		hb_armed = true;
+		hb_last = now;
+	} else if (hb_armed && now - hb_last >= CTL_HEARTBEAT_MS) {
+		hb_armed = false;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			ctl_stop();
+		}
+	}
+}
+
+static uint8_t ctl_ping(const struct rpc_args *a)
+{
+	frame_len_t i;
+	for (i = 0; i < a->len; i++)
+		rpc_put_u8(rpc_arg_u8(a, i));
+	return RPC_OK;
+}
+
+static uint8_t ctl_status(const struct rpc_args *a)
+{
+	rpc_put_u32(tick_ms());
+	rpc_put_u8(chan_drops());
+	rpc_put_u8(frame_recv_crc_errors());
+	rpc_put_u8(enabled);
+	return RPC_OK;
+}
+
+static bool same_pin(const struct pin *a, const struct pin *b)
+{
+	return a->port == b->port && a->mask == b->mask;
+}
+
+static uint8_t ctl_motor_en(const struct rpc_args *a)
+{
+	uint8_t m = rpc_arg_u8(a, 0), i;
+	if (m >= CTL_MOTORS)
+		return RPC_E_ARG;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (rpc_arg_u8(a, 1)) {
+			enabled |= 1 << m;
+			mshb_enable(m);
+			return RPC_OK;
+		}
+
+		enabled &= ~(1 << m);
+		/* the bridges may share an enable line */
+		for (i = 0; i < CTL_MOTORS; i++)
+			if ((enabled & (1 << i)) && same_pin(
+					&mshb_d[i].enable, &mshb_d[m].enable))
+				return RPC_OK;
+		mshb_disable(m);
+	}
+	return RPC_OK;
+}
+
+static uint8_t ctl_motor_set(const struct rpc_args *a)
+{
+	uint8_t m = rpc_arg_u8(a, 0);
+	int16_t speed = rpc_arg_u16(a, 1);
+	if (m >= CTL_MOTORS || speed == INT16_MIN)
+		return RPC_E_ARG;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		mshb_set(m, speed);
+	}
+	return RPC_OK;
+}
+
+static uint8_t ctl_pid_gains(const struct rpc_args *a)
+{
+	uint8_t l = rpc_arg_u8(a, 0);
+	int16_t ilimit = rpc_arg_u16(a, 13);
+	if (l >= CTL_MOTORS || ilimit < 0)
+		return RPC_E_ARG;
+
+	pid_set_kp(pid[l], (int32_t)rpc_arg_u32(a, 1));
+	pid_set_ki(pid[l], (int32_t)rpc_arg_u32(a, 5));
+	pid_set_kd(pid[l], (int32_t)rpc_arg_u32(a, 9));
+	pid[l].ilimit = ilimit;
+	return RPC_OK;
+}
+
+static uint8_t ctl_pid_target(const struct rpc_args *a)
+{
+	uint8_t l = rpc_arg_u8(a, 0);
+	if (l >= CTL_MOTORS)
+		return RPC_E_ARG;
+
+	pid_set_goal(pid[l], (int16_t)rpc_arg_u16(a, 1));
+	return RPC_OK;
+}
+
+static uint8_t ctl_pid_get(const struct rpc_args *a)
+{
+	uint8_t l = rpc_arg_u8(a, 0);
+	if (l >= CTL_MOTORS)
+		return RPC_E_ARG;
+
+	rpc_put_u32(pid[l].kp);
+	rpc_put_u32(pid[l].ki);
+	rpc_put_u32(pid[l].kd);
+	rpc_put_u16(pid[l].ilimit);
+	rpc_put_u16(pid[l].target);
+	return RPC_OK;
+}
+
+static uint8_t ctl_pid_step(const struct rpc_args *a)
+{
+	uint8_t l = rpc_arg_u8(a, 0);
+	if (l >= CTL_MOTORS)
+		return RPC_E_ARG;
+
+	int16_t out = pid_update(&pid[l], (int16_t)rpc_arg_u16(a, 1));
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		mshb_set(l, out == INT16_MIN ? -INT16_MAX : out);
+	}
+	rpc_put_u16(out);
+	return RPC_OK;
+}
+
+static const struct rpc_cmd ctl_cmds[RPC_COUNT] RPC_TABLE = {
+	[RPC_PING]       = { ctl_ping,       RPC_ARGS_ANY },
+	[RPC_STATUS]     = { ctl_status,     0 },
+	[RPC_MOTOR_EN]   = { ctl_motor_en,   2 },
+	[RPC_MOTOR_SET]  = { ctl_motor_set,  3 },
+	[RPC_PID_GAINS]  = { ctl_pid_gains,  15 },
+	[RPC_PID_TARGET] = { ctl_pid_target, 3 },
+	[RPC_PID_GET]    = { ctl_pid_get,    1 },
+	[RPC_PID_STEP]   = { ctl_pid_step,   3 },
+	[RPC_LINK_STATS] = { rpc_link_stats, 1 },
+};
+
+void ctl_init(void)
+{
+	mshb_init();
+	enabled = 0;
+	hb_beat = hb_armed = false;
+	memset(pid, 0, sizeof(pid));
+	rpc_init(ctl_cmds, ARRAY_SIZE(ctl_cmds));
+	chan_set_fast(FAST_STOP, ctl_stop);
+	chan_set_fast(FAST_HEARTBEAT, ctl_heartbeat);
+}
@@ -0,0 +1,27 @@
+#ifndef CTL_H_
+#define CTL_H_ 1
+
+#include <stdint.h>
+
+/* Motor control over RPC: the motor_shb.h outputs and a pid.h loop per
+ * motor, commands in proto.h. The loops have no feedback of their own, the
+ * host closes them by sending measurements with RPC_PID_STEP.
+ *
+ * FAST_STOP disables and zeroes all outputs from the RX ISR (with
+ * FRAME_FAST). Once a FAST_HEARTBEAT has arrived, going CTL_HEARTBEAT_MS
+ * without another does the same, until the next one.
+ */
+
+#ifndef CTL_HEARTBEAT_MS
+# define CTL_HEARTBEAT_MS 250
+#endif
+
+/* set up the motors (disabled, stopped) and loops (zeroed), and hand the
+ * command table to rpc_init() and the fast ops to chan_set_fast(). Call
+ * with interrupts off, after chan_init(). */
+void ctl_init(void);
+
+/* check the heartbeat. now: tick_ms() */
+void ctl_poll(uint32_t now);
+
+#endif
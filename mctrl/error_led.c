@@ -1,5 +1,6 @@
 #include <avr/io.h>
 #include <util/delay.h>
+#include <stdbool.h>
 #include "common.h"
 
 #define DELAY_TIME 250
@@ -11,6 +12,14 @@ void led_init(void)
 	DDR(LED_P) |= (1 << LED_PIN);
 }
 
+void led_set(bool on)
+{
+	if (on)
+		PORT(LED_P) |= (1 << LED_PIN);
+	else
+		PORT(LED_P) &= ~(1 << LED_PIN);
+}
+
 void led_flash(uint8_t i)
 {
 	do {
@@ -2,7 +2,10 @@
 #define ERROR_LED_H_ 1
 
 #include <stdint.h>
+#include <stdbool.h>
 void led_init(void);
+/* blocks for ~(2 * i + 1) * 250ms */
 void led_flash(uint8_t i);
+void led_set(bool on);
 
 #endif
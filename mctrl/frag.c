@@ -0,0 +1,125 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "link.h"
+#include "proto.h"
+#include "frag.h"
+
+/*** Sending ***/
+void frag_tx_init(struct frag_tx *t, link_xmit_fn xmit, uint8_t frag_max)
+{
+	t->xmit = xmit;
+	t->data = NULL;
+	t->msg = 0;
+	if (frag_max < 1)
+		frag_max = 1;
+	if (frag_max > FRAG_DATA_MAX)
+		frag_max = FRAG_DATA_MAX;
+	t->frag_max = frag_max;
+}
+
+bool frag_send(struct frag_tx *t, const void *data, uint16_t len)
+{
+	if (t->data || !len || len > FRAG_MSG_MAX(t->frag_max))
+		return false;
+
+	t->data = data;
+	t->len = len;
+	t->off = 0;
+	t->seq = 0;
+	frag_tx_poll(t);
+	return true;
+}
+
+bool frag_tx_poll(struct frag_tx *t)
+{
+	uint8_t f[FRAG_HDR_LEN + FRAG_DATA_MAX];
+
+	while (t->data) {
+		uint16_t left = t->len - t->off;
+		uint8_t n = left > t->frag_max ? t->frag_max : left;
+		bool last = n == left;
+
+		f[0] = LINK_U_UI;
+		f[1] = t->msg;
+		f[2] = t->seq | (last ? FRAG_LAST : 0);
+		memcpy(f + FRAG_HDR_LEN, t->data + t->off, n);
+		if (!t->xmit(f, FRAG_HDR_LEN + n))
+			return false;
+
+		t->off += n;
+		t->seq++;
+		if (last) {
+			t->data = NULL;
+			t->msg++;
+		}
+	}
+	return true;
+}
+
+/*** Receiving ***/
+void frag_rx_init(struct frag_rx *r, void *buf, uint16_t cap,
+		uint16_t timeout)
+{
+	r->buf = buf;
+	r->cap = cap;
+	r->active = false;
+	r->timeout = timeout;
+	r->now = 0;
+	r->discards = 0;
+}
+
+static void frag_discard(struct frag_rx *r)
+{
+	if (r->active) {
+		r->active = false;
+		r->discards++;
+	}
+}
+
+uint16_t frag_recv(struct frag_rx *r, const uint8_t *frame, uint8_t len)
+{
+	if (len < FRAG_HDR_LEN)
+		return 0;
+
+	uint8_t msg = frame[1];
+	uint8_t seq = frame[2] & FRAG_SEQ_MASK;
+	uint8_t n = len - FRAG_HDR_LEN;
+
+	if (!seq) {
+		/* a new message, whatever was in progress is lost */
+		frag_discard(r);
+		r->active = true;
+		r->msg = msg;
+		r->seq = 0;
+		r->len = 0;
+	} else if (!r->active || msg != r->msg || seq != r->seq) {
+		/* missed something: the rest of this message is useless */
+		frag_discard(r);
+		return 0;
+	}
+
+	if (n > r->cap - r->len) {
+		frag_discard(r);
+		return 0;
+	}
+
+	memcpy(r->buf + r->len, frame + FRAG_HDR_LEN, n);
+	r->len += n;
+	r->seq++;
+	r->last = r->now;
+
+	if (!(frame[2] & FRAG_LAST))
+		return 0;
+
+	r->active = false;
+	return r->len;
+}
+
+void frag_rx_poll(struct frag_rx *r, uint16_t now)
+{
+	r->now = now;
+	if (r->active && (uint16_t)(now - r->last) >= r->timeout)
+		frag_discard(r);
+}
@@ -0,0 +1,106 @@
+#ifndef FRAG_H_
+#define FRAG_H_ 1
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "link.h"
+#include "proto.h"
+
+/* Fragmentation of messages larger than a frame (SD sectors, calibration
+ * tables) into UI frames, and their reassembly (see proto.h for the header).
+ *
+ * Fragments are not acknowledged or retransmitted, they go out back to back
+ * as fast as the framing layer takes them. The receiver copies each into a
+ * buffer supplied by the caller. A fragment out of sequence (one was lost)
+ * discards the message, as does no fragment arriving for `timeout` ticks.
+ * Whatever sits above should retry whole messages.
+ *
+ * The same code is used by the firmware (over frame_send/frame_recv_*) and
+ * by the host tools in pc/.
+ */
+
+/* max number of data bytes in a fragment. With the header and crc a full
+ * fragment has to fit the receiver's rx ring. */
+#ifndef FRAG_DATA_MAX
+# define FRAG_DATA_MAX 24
+#endif
+
+/* max length of a message of fragments of `frag_max` bytes */
+#define FRAG_MSG_MAX(frag_max) ((uint16_t)(FRAG_SEQ_MASK + 1) * (frag_max))
+
+#define FRAG_IS(ctrl) (((ctrl) & ~LINK_PF) == LINK_U_UI)
+
+/*** Sending ***/
+struct frag_tx {
+	link_xmit_fn xmit;
+	const uint8_t *data; /* message being sent, NULL if none */
+	uint16_t len;
+	uint16_t off;        /* of the next fragment in data */
+	uint8_t msg;
+	uint8_t seq;
+	uint8_t frag_max;
+};
+
+/* frag_max: data bytes per fragment, 1 .. FRAG_DATA_MAX. */
+void frag_tx_init(struct frag_tx *t, link_xmit_fn xmit, uint8_t frag_max);
+
+/* start sending a message. data must stay valid and unchanged until
+ * frag_tx_busy() says it has all gone out.
+ * return: false if another message is still being sent, or len is 0 or
+ *         larger than FRAG_MSG_MAX(frag_max).
+ */
+bool frag_send(struct frag_tx *t, const void *data, uint16_t len);
+
+static inline bool frag_tx_busy(const struct frag_tx *t)
+{
+	return t->data;
+}
+
+/* hand xmit as many fragments as it takes. Call regularly while
+ * frag_tx_busy().
+ * return: true once the whole message is out.
+ */
+bool frag_tx_poll(struct frag_tx *t);
+
+/*** Receiving ***/
+struct frag_rx {
+	uint8_t *buf;
+	uint16_t cap;
+	uint16_t len;     /* bytes of the message so far */
+	uint8_t msg;
+	uint8_t seq;      /* next one expected */
+	bool active;      /* a message is being reassembled */
+	uint16_t timeout;
+	uint16_t now;     /* time of the last frag_rx_poll() */
+	uint16_t last;    /* time the last fragment arrived */
+
+	/* messages discarded incomplete: a lost fragment, a timeout or not
+	 * fitting in buf */
+	uint16_t discards;
+};
+
+/* buf: where messages are reassembled, cap bytes.
+ * timeout: in units of the `now` passed to frag_rx_poll().
+ */
+void frag_rx_init(struct frag_rx *r, void *buf, uint16_t cap,
+		uint16_t timeout);
+
+/* frame: a received frame, control byte first, for which FRAG_IS(frame[0]).
+ * return: the length of the message in buf once its last fragment is in,
+ *         0 otherwise. The message stays in buf until the next fragment is
+ *         passed in.
+ */
+uint16_t frag_recv(struct frag_rx *r, const uint8_t *frame, uint8_t len);
+
+/* reassemble the messages to come in buf instead, cap bytes as before,
+ * leaving the one frag_recv() has just returned where it is. */
+static inline void frag_rx_set_buf(struct frag_rx *r, void *buf)
+{
+	r->buf = buf;
+}
+
+/* discard a message which has stalled. Call regularly, `now` is a free
+ * running tick count (wraps). */
+void frag_rx_poll(struct frag_rx *r, uint16_t now);
+
+#endif
@@ -3,6 +3,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "frame_gen.h"
+
+/* The default channel (the host link on USART0). Other channels may be
+ * created with FRAME_DEFINE, see frame_gen.h */
+FRAME_DECLARE(usart0)
+
+/* configures USART0 */
 void frame_init(void);
 
 #if defined(DEBUG)
@@ -12,8 +19,8 @@ void frame_timeout(void);
 
 #ifndef AVR
 /* For simulating interrupts on non-avr hardware */
-void frame_tx_isr(void);
-void frame_rx_isr(void);
+#define frame_tx_isr frame_fn(usart0, tx_isr)
+#define frame_rx_isr frame_fn(usart0, rx_isr)
 #endif
 
 /*** Transmision ***/
@@ -24,26 +31,48 @@ void frame_rx_isr(void);
  */
 
 /* begin construction of a packet */
-void frame_start(void);
+#define frame_start frame_fn(usart0, start)
 
 /* various appends */
-void frame_append_u8(uint8_t n);
-void frame_append_u16(uint16_t n);
+#define frame_append_u8 frame_fn(usart0, append_u8)
+#define frame_append_u16 frame_fn(usart0, append_u16)
 
 /* dispatch the constructed packet */
-void frame_done(void);
+#define frame_done frame_fn(usart0, done)
 
 /** Full Packet transmit **/
-void frame_send(const void *data, uint8_t nbytes);
+/* return: true if the packet was queued, false if it was dropped for lack
+ *         of buffer space.
+ */
+#define frame_send frame_fn(usart0, send)
+
+/* seg: array of nseg segments which are sent, in order, as one packet.
+ * return: as frame_send.
+ *
+ * Buffer space for the whole packet is checked once up front, each segment
+ * is then copied in with at most 2 memcpy()s (without FRAME_TX_PRE_ESCAPE).
+ * With FRAME_CREDITS, frame_sendv(NULL, 0) sends a frame of only the credits.
+ */
+#define frame_sendv frame_fn(usart0, sendv)
+
+/** Urgent transmit (FRAME_TX_URGENT) **/
+/* as frame_send/frame_sendv, but queued in the urgent ring: the packet goes
+ * out as soon as the one on the wire is done, ahead of any queued with
+ * frame_send. Meant for short replies which must not wait behind bulk data.
+ */
+#define frame_send_urgent frame_fn(usart0, send_urgent)
+#define frame_sendv_urgent frame_fn(usart0, sendv_urgent)
 
 /*** Reception ***/
 
-/* 2 paths possible for recviever:
+/* 3 paths possible for recviever:
  *  - call frame_recv_len (returns 0 if no packet is ready) to see if there is
  *    a packet, subsequently recv data via frame_recv_byte & frame_recv_copy.
  *  - call frame_recv_copy (returns 0 if no packet) and either have all data
  *    returned in the single copy call, or use subsequent
  *    frame_recv_{copy,byte} calls to get all the data.
+ *  - call frame_recv_peek (returns 0 if no packet) to get pointers to the
+ *    packet data in the ring and parse it in place, then frame_recv_commit.
  * Once done recieving current packet, call frame_recv_next to advance to the
  * next packet. Packets *are not* advanced automatically under any condition.
  */
@@ -53,12 +82,12 @@ void frame_send(const void *data, uint8_t nbytes);
  * return: length of current packet, not the amount copied into dst.
  * byte pointer is advanced by MIN(len, packet_len)
  */
-uint8_t frame_recv_copy(uint8_t *dst, uint8_t dst_len);
+#define frame_recv_copy frame_fn(usart0, recv_copy)
 
 /* return: number of bytes in the current packet. 0 indicates the lack of
  * a packet (packets cannot be 0 bytes).
  */
-uint8_t frame_recv_len(void);
+#define frame_recv_len frame_fn(usart0, recv_len)
 
 /* return: next byte from packet.
  * advances byte pointer.
@@ -69,7 +98,23 @@ uint8_t frame_recv_len(void);
  * packet and thus should not be used to indicate the packet is
  * fully processed.
  */
-uint8_t frame_recv_byte(void);
+#define frame_recv_byte frame_fn(usart0, recv_byte)
+
+/** Zero-copy reception **/
+/* seg: array of 2 segments filled with the unread part of the current
+ *      packet as it sits in the receive ring. seg[1].len is 0 unless the
+ *      packet wraps around the end of the ring.
+ * return: number of unread bytes in the current packet (the sum of the
+ *         segment lengths), 0 if there is no packet.
+ *
+ * The byte pointer is not advanced; the segments stay valid until
+ * frame_recv_commit() (or frame_recv_next()) is called.
+ */
+#define frame_recv_peek frame_fn(usart0, recv_peek)
+
+/* release the segments returned by frame_recv_peek() along with the rest of
+ * the current packet and advance to the next packet. */
+#define frame_recv_commit frame_fn(usart0, recv_commit)
 
 /* advance the packet pointer to the next packet.
  *
@@ -80,16 +125,56 @@ uint8_t frame_recv_byte(void);
  *    which ensures that at least one packet (the one presently being
  *    processed) will be in the packet queue.
  */
-void frame_recv_next(void);
+#define frame_recv_next frame_fn(usart0, recv_next)
 
 /* return: true if at least one packet is in the queue. The queue includes
  *         the packet currently being processed.
  */
-bool frame_recv_have_pkt(void);
+#define frame_recv_have_pkt frame_fn(usart0, recv_have_pkt)
 
 /* return: the number of packets presently in the queue. The queue includes
  *         the packet currently being processed.
  */
-uint8_t frame_recv_ct(void);
+#define frame_recv_ct frame_fn(usart0, recv_ct)
+
+/*** Addressing ***/
+/* with FRAME_ADDR, set the node address (0 .. FRAME_ADDR_NODE_MAX) this
+ * channel accepts frames for and sends from. Multicast frames are always
+ * accepted.
+ * return: false if node is not a valid address.
+ */
+#define frame_set_addr frame_fn(usart0, set_addr)
+
+/*** Fast frames ***/
+/* with FRAME_FAST, fn is called from the RX ISR with every good frame of at
+ * most FRAME_FAST bytes, the moment its closing flag arrives. Returning
+ * true drops the frame, false queues it as usual. NULL (the default) queues
+ * everything. Set it with interrupts off. */
+#define frame_set_fast frame_fn(usart0, set_fast)
+
+/*** Speed ***/
+/* switch the usart to the given UBRR and U2X setting, at once. Anything
+ * still being sent or received is garbled, see frame_tx_drained().
+ * FRAME_UBRR_DEFAULT/FRAME_U2X_DEFAULT is the FRAME_BAUD setting
+ * frame_init() starts with.
+ */
+#define frame_set_ubrr frame_fn(usart0, set_ubrr)
+
+/* return: true once everything queued has been sent, including the
+ *         last bit of the closing flag.
+ */
+#define frame_tx_drained frame_fn(usart0, tx_drained)
+
+/*** Statistics ***/
+/* return: number of received frames dropped due to a crc mismatch (or being
+ *         too short to hold a crc). Wraps.
+ */
+#define frame_recv_crc_errors frame_fn(usart0, recv_crc_errors)
+
+/* s: filled with the counters and high-water marks (struct frame_stats in
+ *    frame_gen.h), all read at once.
+ * clear: zero them after, so the next read starts afresh.
+ */
+#define frame_stats_get frame_fn(usart0, stats_get)
 
 #endif
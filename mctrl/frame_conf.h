@@ -0,0 +1,61 @@
+#ifndef FRAME_CONF_H_
+#define FRAME_CONF_H_
+
+/* Escape and crc packets as they are queued (frame_send, frame_append_*)
+ * instead of in the TX ISR, leaving the ISR a plain byte pump. tx then
+ * holds escaped frames, frame_async.c gives it 64 bytes instead of 32.
+ *
+ * Worst case ISR cycles, atmega328p, -Os, this file's defaults otherwise
+ * (longest path through the disassembly, vector to reti, not counting the
+ * 7 cycles of interrupt response and vector jump):
+ *                         TX (UDRE)       RX
+ *   escape in the ISR     211, 15 regs    237, 19 regs
+ *   FRAME_TX_PRE_ESCAPE   106, 10 regs    237, 19 regs
+ * 211 cycles is 13us at 16MHz, against 4167 cycles per byte at 38400
+ * baud. */
+//#define FRAME_TX_PRE_ESCAPE
+
+/* COBS encode frames instead of HDLC escaping them (see proto.h), which
+ * bounds the overhead to a byte per 254 whatever the data. The encoding is
+ * done as frames are queued, so this needs FRAME_TX_PRE_ESCAPE. */
+//#define FRAME_COBS
+
+/* Multi-drop: frames carry an addr8 after the opening flag, frames for
+ * other nodes are dropped by the RX ISR. See frame_set_addr(). The pc/
+ * tools need -a node to talk to such a board. */
+//#define FRAME_ADDR
+
+/* Credit based flow control: outgoing frames advertise the free space of
+ * the receive rings, so the sender never overflows them. The pc/ tools
+ * need -k, which strips the credits and keeps to them (rtt -l follows the
+ * build). */
+//#define FRAME_CREDITS
+
+/* A second transmit ring of this many bytes (a power of 2) for
+ * frame_send_urgent(). Its frames go out ahead of those queued with
+ * frame_send, as soon as the frame on the wire is finished. */
+//#define FRAME_TX_URGENT 16
+
+/* Good frames of at most this many bytes are offered to the frame_set_fast()
+ * handler straight from the RX ISR as their closing flag arrives, instead
+ * of waiting in rx for the main loop. Meant for stop commands; without it
+ * CHAN_FAST frames are still acted on, from chan_poll().
+ * Cost (atmega328p, -Os, counted from the disassembly): 2 more registers
+ * saved in the RX ISR, 8 cycles on every byte received, and up to 105
+ * cycles plus the handler's own on the closing flag of a short frame. */
+//#define FRAME_FAST 2
+
+/* 16 bit ring indexes, for frames longer than 255 bytes (a whole 512 byte SD
+ * block, say). frame_async.c then gives the host link 1KiB rings each way,
+ * so this is for the parts with 4KiB of RAM or more. Replies can then
+ * queue behind up to 1KiB of bulk data, see FRAME_TX_URGENT. Not with
+ * FRAME_CREDITS. */
+//#define FRAME_JUMBO
+
+/* Hold a pin high for the duration of each frame ISR, for measuring ISR
+ * length with a scope. */
+//#define FRAME_PROBE_P B
+#define FRAME_PROBE_RX_PIN 3
+#define FRAME_PROBE_TX_PIN 4
+
+#endif
@@ -0,0 +1,1654 @@
+#ifndef FRAME_GEN_H_
+#define FRAME_GEN_H_ 1
+
+/* Generator for framed (HDLC-like) links over a USART.
+ *
+ * FRAME_DEFINE(name, usart_n, rx_sz, rx_pkts, tx_sz, tx_pkts)
+ *   stamps out the ring buffers, ISRs and API of a framing channel on
+ *   USART<usart_n>. rx_sz/tx_sz are the byte ring sizes, rx_pkts/tx_pkts the
+ *   size of the packet index rings (one less packet than that may be
+ *   queued). All sizes must be powers of 2, no larger than 256 (rx_sz and
+ *   tx_sz up to 32768 with FRAME_JUMBO).
+ *
+ * FRAME_DECLARE(name)
+ *   prototypes for the functions FRAME_DEFINE(name, ...) generates, for use
+ *   in headers.
+ *
+ * The generated functions are named frame_fn(name, x) (frame_<name>_<x>) and
+ * behave as documented for the default channel in frame_async.h.
+ *
+ * Example: two links on an atmega640
+ *	FRAME_DEFINE(host, 0, 64, 8, 64, 8)
+ *	FRAME_DEFINE(telem, 1, 16, 4, 256, 32)
+ *	...
+ *	frame_fn(telem, send)(buf, len);
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "crc16.h"
+#include "ds/circ_buf.h"
+
+#include "proto.h"
+#include "frame_conf.h"
+
+/* 0x7f => 0x7d, 0x5f
+ * 0x7e => 0x7d, 0x5e
+ * 0x7d => 0x7d, 0x5d
+ */
+
+/* HDLC
+ * [flag] [address] [ctrl] [data] [crc] [flag]
+ * addr8 : [multicast:1] [node addr:6] ['1':1]
+ * addr16: [multicast:1] [node addr:6] ['0':1] [node addr:7] [end addr:1]...
+ * ctrl  : used by the reliable delivery layer, see link.h
+ */
+
+/* ctrl:
+ * Frame 7 6 5 4   3 2 1 0
+ * I     N(R)  p   N(S)  0
+ * S     N(R)  p/f S S 0 1
+ * U     M M M p/f M M 1 1
+ */
+
+/* LC:
+ *  [flag:8] [addr:8] [len:8] [data1:len] [crc:16] [flag:8] ...
+ * data1:
+ *  []
+ */
+
+/* Presently on the wire:
+ *  [flag:8] [addr:8] [data:n] [crc:16] [flag:8]
+ * addr is the addr8 form above and is only present with FRAME_ADDR
+ * (frame_conf.h), for several nodes sharing one bus. The RX ISR looks at
+ * it as soon as it arrives and ignores the rest of frames which are
+ * neither multicast nor for this node, so they never take up space in
+ * rx.buf or rx.p_idx. Nodes send their own address. The address is not
+ * stored in rx.buf and is added to outgoing frames by the framing layer.
+ *
+ * crc is CRC-16/CCITT (see crc16.h) over the unescaped data, sent high byte
+ * first and escaped like the data. It is appended by the TX ISR as the bytes
+ * go out and checked by the RX ISR as they arrive, so it never occupies space
+ * in tx.buf and is stripped from rx.buf before the packet is made visible.
+ * Frames which fail the check are dropped and counted (recv_crc_errors,
+ * and with the other errors in struct frame_stats).
+ *
+ * With FRAME_CREDITS (frame_conf.h) outgoing frames carry credits for the
+ * receiving side of this end, following addr:
+ *  [flag:8] [addr:8] [rx_frames:8] [free_slots:8] [free_bytes:8] [data:n] ...
+ * rx_frames counts (mod 256) the frames the RX ISR has seen end, good or
+ * not, free_slots and free_bytes are the room left in rx.p_idx and rx.buf
+ * after those. A sender which keeps track of the frames it has sent since
+ * can then avoid ever overflowing the rings (see pc/credit.h). The TX ISR
+ * takes the credits as each frame goes out, except with FRAME_TX_PRE_ESCAPE
+ * where that happens as the frame is queued. When recv_next frees space and
+ * no frame taking the credits after that has been queued by the time tx.buf
+ * is empty, a frame with only the credits is sent, once the receiver has
+ * emptied rx or freed half its packet slots. That is checked by recv_next
+ * and whenever the receiver polls (recv_len, recv_peek, ...).
+ *
+ * With FRAME_TX_PRE_ESCAPE (frame_conf.h) the escaping and crc are instead
+ * done by frame_send/frame_append_* as the packet is queued, tx.buf holds
+ * the bytes exactly as they go on the wire and the TX ISR only has to copy
+ * them out and add the flags. This shortens the TX ISR at the cost of
+ * escapes occupying space in tx.buf.
+ *
+ * With FRAME_COBS (frame_conf.h) the frames are COBS encoded instead, with
+ * zeros for flags (proto.h). The encoding is done as with
+ * FRAME_TX_PRE_ESCAPE, which it needs: the code byte starting each block
+ * is reserved in tx.buf when the block is opened and filled in once the
+ * block ends. The RX ISR decodes a byte at a time as with HDLC, a code byte
+ * yielding the zero which ended the previous block, if any.
+ *
+ * With FRAME_FAST (frame_conf.h) the RX ISR hands each good frame of at most
+ * FRAME_FAST bytes to the frame_set_fast() handler as soon as the closing
+ * flag is in, before it is made visible in rx. A frame the handler takes is
+ * dropped from rx.buf again, so it never waits behind queued frames.
+ *
+ * With FRAME_JUMBO (frame_conf.h) byte indexes and frame lengths
+ * (frame_len_t) are 16 bit, so rings may be larger than 256 bytes and
+ * frames longer than 255. Packet indexes stay 8 bit. It costs some 16 bit
+ * loads and stores per byte in both ISRs.
+ *
+ * With FRAME_TX_URGENT (frame_conf.h) there is a second, small transmit ring,
+ * txu, filled by frame_send_urgent/frame_sendv_urgent. Whenever the TX ISR
+ * finishes a frame it goes on with the next one in txu if there is any, so
+ * an urgent frame waits for at most the frame on the wire, not for all of
+ * tx.buf. The rings are otherwise alike: frames in each go out in order.
+ */
+
+#if defined(FRAME_ADDR)
+# define F_ADDR_EN 1
+#else
+# define F_ADDR_EN 0
+#endif
+
+#if defined(FRAME_CREDITS)
+# define F_CREDIT_LEN FRAME_CREDIT_LEN
+#else
+# define F_CREDIT_LEN 0
+#endif
+
+#if defined(FRAME_TX_PRE_ESCAPE)
+# define F_TX_PRE_ESCAPE_EN 1
+#else
+# define F_TX_PRE_ESCAPE_EN 0
+#endif
+
+#if defined(FRAME_COBS)
+# if !defined(FRAME_TX_PRE_ESCAPE)
+#  error "FRAME_COBS needs FRAME_TX_PRE_ESCAPE"
+# endif
+# define F_COBS_EN 1
+# define F_FLAG COBS_DELIM
+#else
+# define F_COBS_EN 0
+# define F_FLAG START_BYTE
+#endif
+
+#if defined(FRAME_FAST)
+# define F_FAST_LEN FRAME_FAST
+#else
+# define F_FAST_LEN 0
+#endif
+
+/* byte indexes into the rings, and frame lengths */
+#if defined(FRAME_JUMBO)
+# if defined(FRAME_CREDITS)
+#  error "FRAME_CREDITS can't advertise FRAME_JUMBO rings, credits are 8 bit"
+# endif
+typedef uint16_t frame_len_t;
+# define F_BUF_MAX 32768
+#else
+typedef uint8_t frame_len_t;
+# define F_BUF_MAX 256
+#endif
+
+#if defined(FRAME_TX_URGENT)
+# define F_TX_URGENT_EN 1
+# ifndef FRAME_TX_URGENT_PKTS
+#  define FRAME_TX_URGENT_PKTS 4
+# endif
+#else
+# define F_TX_URGENT_EN 0
+#endif
+
+#define frame_var(_name_, var) CAT3(frame_,_name_,_##var)
+#define frame_fn(_name_, fn)   CAT3(frame_,_name_,_##fn)
+
+#ifndef CAT3
+# define CAT3(x,y,z) x##y##z
+#endif
+
+/* composition of register & bit names for USART<n> */
+#define F_REGN_A(base, n)    _F_REGN_A(base, n)
+#define _F_REGN_A(base, n)   base##n
+#define F_REGN_I(base, n, x)  _F_REGN_I(base, n, x)
+#define _F_REGN_I(base, n, x) base##n##x
+
+#if defined(AVR)
+# include <avr/io.h>
+# include <avr/interrupt.h>
+
+/* parts with a single usart (atmega328p) don't number the vectors */
+# if defined(USART_RX_vect) && !defined(USART0_RX_vect)
+#  define USART0_RX_vect   USART_RX_vect
+#  define USART0_UDRE_vect USART_UDRE_vect
+# endif
+
+# define F_UDRE_ISR_ON(n)  (F_REGN_I(UCSR, n, B) |= (1 << F_REGN_A(UDRIE, n)))
+# define F_UDRE_ISR_OFF(n) (F_REGN_I(UCSR, n, B) &= ~(1 << F_REGN_A(UDRIE, n)))
+
+# define F_RX_BYTE_GET(n) F_REGN_A(UDR, n)
+# define F_RX_STATUS_GET(n) F_REGN_I(UCSR, n, A)
+# define F_RX_STATUS_IS_ERROR(n, status) ((status) &			\
+		((1 << F_REGN_A(FE, n)) | (1 << F_REGN_A(DOR, n))	\
+		 | (1 << F_REGN_A(UPE, n))))
+/* bit is one of FE, DOR, UPE */
+# define F_RX_STATUS_IS(n, status, bit) ((status) & (1 << F_REGN_A(bit, n)))
+
+# define F_TX_BYTE_SEND(n, byte) (F_REGN_A(UDR, n) = (byte))
+/* TXC: the last byte written to UDR has been shifted out. Cleared by
+ * writing a 1, the other writable bit in UCSRnA is U2X. */
+# define F_TX_DONE(n) (F_REGN_I(UCSR, n, A) & (1 << F_REGN_A(TXC, n)))
+# define F_TX_DONE_CLEAR(n) (F_REGN_I(UCSR, n, A) =			\
+		(F_REGN_I(UCSR, n, A) & (1 << F_REGN_A(U2X, n)))	\
+		| (1 << F_REGN_A(TXC, n)))
+
+# define F_RX_ISR(_name_, n) ISR(F_REGN_I(USART, n, _RX_vect))
+# define F_TX_ISR(_name_, n) ISR(F_REGN_I(USART, n, _UDRE_vect))
+
+# define F_IRQ_SAVE(sreg) do { (sreg) = SREG; cli(); } while (0)
+# define F_IRQ_RESTORE(sreg) (SREG = (sreg))
+
+#else /* !defined(AVR) */
+
+# define F_UDRE_ISR_ON(n)
+# define F_UDRE_ISR_OFF(n)
+
+/* the simulated usart is stdio unless the host build routes it elsewhere
+ * (see pc/frame_sim.c) */
+# ifndef FRAME_SIM_GETC
+#  define FRAME_SIM_GETC() getchar()
+# endif
+# ifndef FRAME_SIM_PUTC
+#  define FRAME_SIM_PUTC(byte) putchar(byte)
+# endif
+
+# define F_RX_BYTE_GET(n) FRAME_SIM_GETC()
+# define F_RX_STATUS_GET(n) 0
+# define F_RX_STATUS_IS_ERROR(n, status) ((void)(status), false)
+# define F_RX_STATUS_IS(n, status, bit) ((void)(status), false)
+
+# define F_TX_BYTE_SEND(n, byte) FRAME_SIM_PUTC(byte)
+# define F_TX_DONE(n) true
+# define F_TX_DONE_CLEAR(n)
+
+/* For simulating interrupts on non-avr hardware */
+# define F_RX_ISR(_name_, n) void frame_fn(_name_, rx_isr)(void)
+# define F_TX_ISR(_name_, n) void frame_fn(_name_, tx_isr)(void)
+
+# define F_IRQ_SAVE(sreg) ((void)(sreg))
+# define F_IRQ_RESTORE(sreg) ((void)(sreg))
+
+#endif
+
+/* FRAME_JUMBO: the AVR loads and stores the 16 bit p_idx entries a byte at
+ * a time. The entry at a ring's tail is the one written on one side while
+ * the other reads it (advanced by the TX ISR in tx, by the reader in rx, and
+ * read for the free space by the other), so the main loop's side goes
+ * through these with interrupts off. An ISR can't be interrupted half way,
+ * and 8 bit entries are plain accesses. */
+#if defined(FRAME_JUMBO)
+static inline frame_len_t _f_idx_get(const frame_len_t *idx)
+{
+	uint8_t sreg;
+	frame_len_t v;
+	F_IRQ_SAVE(sreg);
+	v = *idx;
+	F_IRQ_RESTORE(sreg);
+	return v;
+}
+
+static inline void _f_idx_set(frame_len_t *idx, frame_len_t v)
+{
+	uint8_t sreg;
+	F_IRQ_SAVE(sreg);
+	*idx = v;
+	F_IRQ_RESTORE(sreg);
+}
+# define _F_IDX_GET(idx) _f_idx_get(&(idx))
+# define _F_IDX_SET(idx, v) _f_idx_set(&(idx), (v))
+#else
+# define _F_IDX_GET(idx) (idx)
+# define _F_IDX_SET(idx, v) ((idx) = (v))
+#endif
+
+/* ISR timing probes: with FRAME_PROBE_P set (frame_conf.h) the pins
+ * FRAME_PROBE_RX_PIN and FRAME_PROBE_TX_PIN of that port are held high for
+ * the duration of the RX and TX ISRs, so their length (and worst case) can
+ * be measured with a scope or logic analyzer. Each edge costs 2 cycles.
+ */
+#if defined(AVR) && defined(FRAME_PROBE_P)
+# define F_PROBE_INIT() (DDR(FRAME_PROBE_P) |=				\
+		(1 << FRAME_PROBE_RX_PIN) | (1 << FRAME_PROBE_TX_PIN))
+# define F_PROBE_ON(which)  (PORT(FRAME_PROBE_P) |=			\
+		(1 << FRAME_PROBE_##which##_PIN))
+# define F_PROBE_OFF(which) (PORT(FRAME_PROBE_P) &=			\
+		~(1 << FRAME_PROBE_##which##_PIN))
+#else
+# define F_PROBE_INIT()     do { } while (0)
+# define F_PROBE_ON(which)  do { } while (0)
+# define F_PROBE_OFF(which) do { } while (0)
+#endif
+
+/* A segment of packet data: a piece of a packet in the receive ring
+ * (frame_recv_peek) or one part of a packet to send (frame_sendv). */
+struct frame_seg {
+	const uint8_t *data;
+	frame_len_t len;
+};
+
+/* handler for frames of up to FRAME_FAST bytes, run from the RX ISR.
+ * return: true if it took care of the frame, which is then not queued. */
+typedef bool (*frame_fast_fn)(const uint8_t *data, uint8_t len);
+
+/* What went wrong on a channel, and how full its rings got, for sizing
+ * them and picking a baud rate. The counters are bumped once per event
+ * where it happens (mostly in the ISRs) and wrap, so readers should look at
+ * the difference between two reads, or clear them. The high-water marks
+ * are the most bytes and packets seen queued in rx (as each frame is
+ * queued by the RX ISR) and in tx (as each is queued for sending). With
+ * FRAME_TX_PRE_ESCAPE tx bytes include the escapes. */
+struct frame_stats {
+	uint8_t rx_frame_err;   /* FE: stop bit missing */
+	uint8_t rx_overrun;     /* DOR: a byte arrived before UDR was read */
+	uint8_t rx_parity;      /* UPE */
+	uint8_t rx_crc;         /* bad crc, or too short to hold one */
+	uint8_t rx_no_space;    /* frames dropped, rx.buf full */
+	uint8_t rx_no_slot;     /* frames dropped, rx.p_idx full */
+	uint8_t tx_drops;       /* frames not queued, tx full */
+	uint8_t tx_isr_idle;    /* TX ISR run with nothing to send */
+	frame_len_t rx_bytes_hw;
+	uint8_t rx_pkts_hw;
+	frame_len_t tx_bytes_hw;
+	uint8_t tx_pkts_hw;
+};
+
+#if defined(AVR)
+# define _F_DECLARE_SIM(_name_)
+#else
+# define _F_DECLARE_SIM(_name_)						\
+	void frame_fn(_name_, rx_isr)(void);				\
+	void frame_fn(_name_, tx_isr)(void);
+#endif
+
+#if defined(FRAME_TX_URGENT)
+# define _F_DECLARE_URGENT(_name_)					\
+	bool frame_fn(_name_, send_urgent)(const void *data,		\
+						frame_len_t nbytes);	\
+	bool frame_fn(_name_, sendv_urgent)(const struct frame_seg *seg, \
+							uint8_t nseg);
+#else
+# define _F_DECLARE_URGENT(_name_)
+#endif
+
+#define FRAME_DECLARE(_name_)						\
+	void frame_fn(_name_, init)(void);				\
+	_F_DECLARE_SIM(_name_)						\
+	_F_DECLARE_URGENT(_name_)					\
+	void frame_fn(_name_, start)(void);				\
+	void frame_fn(_name_, append_u8)(uint8_t n);			\
+	void frame_fn(_name_, append_u16)(uint16_t n);			\
+	void frame_fn(_name_, done)(void);				\
+	bool frame_fn(_name_, send)(const void *data, frame_len_t nbytes); \
+	bool frame_fn(_name_, sendv)(const struct frame_seg *seg,	\
+							uint8_t nseg);	\
+	frame_len_t frame_fn(_name_, recv_copy)(uint8_t *dst,		\
+						frame_len_t dst_len);	\
+	frame_len_t frame_fn(_name_, recv_len)(void);			\
+	uint8_t frame_fn(_name_, recv_byte)(void);			\
+	frame_len_t frame_fn(_name_, recv_peek)(struct frame_seg *seg);	\
+	void frame_fn(_name_, recv_next)(void);				\
+	static inline void frame_fn(_name_, recv_commit)(void)		\
+	{								\
+		frame_fn(_name_, recv_next)();				\
+	}								\
+	bool frame_fn(_name_, recv_have_pkt)(void);			\
+	uint8_t frame_fn(_name_, recv_ct)(void);			\
+	uint8_t frame_fn(_name_, recv_crc_errors)(void);		\
+	void frame_fn(_name_, stats_get)(struct frame_stats *s, bool clear); \
+	bool frame_fn(_name_, set_addr)(uint8_t node);			\
+	void frame_fn(_name_, set_fast)(frame_fast_fn fn);		\
+	void frame_fn(_name_, set_ubrr)(uint16_t ubrr, bool u2x);	\
+	bool frame_fn(_name_, tx_drained)(void);
+
+/* local pointers to the channel's rings, the compiler resolves these to
+ * the static objects so there is no indirection cost. */
+#define _F_RX(_name_) \
+	struct frame_var(_name_, rx) *const rx = &frame_var(_name_, rx)
+#define _F_TX(_name_) _F_LANE(_name_, tx)
+/* `tx` pointing at either transmit ring, tx or txu */
+#define _F_LANE(_name_, what) \
+	struct frame_var(_name_, what) *const tx = &frame_var(_name_, what)
+
+/* sizes must be powers of 2 and fit in the indexes: frame_len_t for
+ * bytes, uint8_t for packets */
+#define _F_SZ_CHECK(_name_, what, sz, max)				\
+	typedef char frame_var(_name_, what##_sz_check)			\
+		[(((sz) & ((sz) - 1)) == 0 && (sz) <= (max)) ? 1 : -1];
+
+#define _F_DEF_STRUCT(_name_, what, _sz_, _pkts_)			\
+_F_SZ_CHECK(_name_, what##_buf, _sz_, F_BUF_MAX)			\
+_F_SZ_CHECK(_name_, what##_p_idx, _pkts_, 256)				\
+static struct frame_var(_name_, what) {					\
+	uint8_t buf[_sz_]; /* bytes */					\
+									\
+	/* array of packet starts in bytes (byte heads and tails,	\
+	 * depending on index */					\
+	frame_len_t p_idx[_pkts_];					\
+	uint8_t head; /* next packet_idx_buf loc to read from (head_packet) */ \
+	uint8_t tail; /* next packet_idx_buf loc to write to  (tail_packet) */ \
+} frame_var(_name_, what);
+
+#define _F_DEF_VARS(_name_)						\
+static struct frame_stats frame_var(_name_, stats);			\
+static bool frame_var(_name_, start_flag);				\
+/* our addr8 (FRAME_ADDR) */						\
+static uint8_t frame_var(_name_, addr) = FRAME_ADDR8(0, 0);		\
+/* frames seen ending by the RX ISR (FRAME_CREDITS) */			\
+static uint8_t frame_var(_name_, rx_frames);				\
+/* frames freed since the last credits were taken, up to 255 */	\
+static uint8_t frame_var(_name_, credits_owed);				\
+/* FRAME_FAST */							\
+static frame_fast_fn frame_var(_name_, fast_fn);			\
+bool frame_fn(_name_, sendv)(const struct frame_seg *seg, uint8_t nseg); \
+_F_DEF_TX_VARS(_name_)
+
+/* update the high-water marks, after a packet was queued */
+#define _F_DEF_HW(_name_)						\
+static inline void frame_fn(_name_, rx_hw)(void)			\
+{									\
+	_F_RX(_name_);							\
+	struct frame_stats *st = &frame_var(_name_, stats);		\
+	uint8_t head = rx->head, tail = rx->tail;			\
+	uint8_t pkts = CIRC_CNT(head, tail, ARRAY_SIZE(rx->p_idx));	\
+	frame_len_t bytes = CIRC_CNT(rx->p_idx[head], rx->p_idx[tail],	\
+							sizeof(rx->buf)); \
+	if (pkts > st->rx_pkts_hw)					\
+		st->rx_pkts_hw = pkts;					\
+	if (bytes > st->rx_bytes_hw)					\
+		st->rx_bytes_hw = bytes;				\
+}									\
+									\
+static inline void frame_fn(_name_, tx_hw)(void)			\
+{									\
+	_F_TX(_name_);							\
+	struct frame_stats *st = &frame_var(_name_, stats);		\
+	uint8_t head = tx->head, tail = tx->tail;			\
+	uint8_t pkts = CIRC_CNT(head, tail, ARRAY_SIZE(tx->p_idx));	\
+	frame_len_t bytes = CIRC_CNT(tx->p_idx[head],			\
+			_F_IDX_GET(tx->p_idx[tail]), sizeof(tx->buf));	\
+	if (pkts > st->tx_pkts_hw)					\
+		st->tx_pkts_hw = pkts;					\
+	if (bytes > st->tx_bytes_hw)					\
+		st->tx_bytes_hw = bytes;				\
+}
+
+/*** Reception of Data ***/
+/** receive: consumer, modifies tail **/
+
+/* fill c[FRAME_CREDIT_LEN] with the credits to send (FRAME_CREDITS).
+ * rx_frames is read first so that any frame ending in between is counted
+ * against the free space twice by the sender, rather than not at all. */
+#define _F_DEF_CREDIT_GET(_name_)					\
+static inline void frame_fn(_name_, credit_get)(uint8_t *c)		\
+{									\
+	_F_RX(_name_);							\
+	uint8_t head = rx->head;					\
+	c[0] = frame_var(_name_, rx_frames);				\
+	/* the RX ISR keeps a slot free past the packet being received */ \
+	c[1] = CIRC_SPACE(head, rx->tail, ARRAY_SIZE(rx->p_idx)) - 1;	\
+	c[2] = CIRC_SPACE(rx->p_idx[CIRC_NEXT(head, ARRAY_SIZE(rx->p_idx))], \
+			rx->p_idx[rx->tail], sizeof(rx->buf));		\
+	/* the TX ISR calls this as the frame goes out, so these are	\
+	 * as fresh as any to come */					\
+	if (!F_TX_PRE_ESCAPE_EN)					\
+		frame_var(_name_, credits_owed) = 0;			\
+}									\
+									\
+/* send a frame with only the credits, if some are owed and there is	\
+ * room. Tried again whenever the receiver polls. Batched: only once the	\
+ * receiver has caught up, or has freed half the packet slots, so a	\
+ * burst of frames is answered by one. Not while a frame is being built	\
+ * with start/append, it sits past tx->head where this one would go. */	\
+static inline void frame_fn(_name_, credit_flush)(void)			\
+{									\
+	_F_RX(_name_);							\
+	uint8_t owed = frame_var(_name_, credits_owed);			\
+	if (F_CREDIT_LEN && owed && !frame_var(_name_, start_flag)	\
+			&& (rx->tail == rx->head			\
+				|| owed >= ARRAY_SIZE(rx->p_idx) / 2)	\
+			&& frame_fn(_name_, tx_idle)())			\
+		frame_fn(_name_, sendv)(NULL, 0);			\
+}
+
+#define _F_DEF_RECV_LEN(_name_)						\
+frame_len_t frame_fn(_name_, recv_len)(void)				\
+{									\
+	frame_fn(_name_, credit_flush)();				\
+	_F_RX(_name_);							\
+	uint8_t p_tail = rx->tail;					\
+	if (p_tail != rx->head) {					\
+		uint8_t p_next = CIRC_NEXT(p_tail, ARRAY_SIZE(rx->p_idx)); \
+		return CIRC_CNT(rx->p_idx[p_next],			\
+				rx->p_idx[p_tail],			\
+				sizeof(rx->buf));			\
+	} else {							\
+		return 0;						\
+	}								\
+}
+
+#define _F_DEF_RECV_BYTE(_name_)					\
+uint8_t frame_fn(_name_, recv_byte)(void)				\
+{									\
+	_F_RX(_name_);							\
+	uint8_t p_curr_tail = rx->tail;					\
+	if (p_curr_tail == rx->head)					\
+		return 0;						\
+									\
+	/* the end is only stable once the packet is in, past rx->head */ \
+	uint8_t p_next_tail = CIRC_NEXT(p_curr_tail, ARRAY_SIZE(rx->p_idx)); \
+	frame_len_t b_curr_tail = rx->p_idx[p_curr_tail];		\
+	frame_len_t b_next_tail = rx->p_idx[p_next_tail];		\
+									\
+	if (b_curr_tail != b_next_tail) {				\
+		uint8_t data = rx->buf[b_curr_tail];			\
+		_F_IDX_SET(rx->p_idx[p_curr_tail],			\
+				CIRC_NEXT(b_curr_tail, sizeof(rx->buf))); \
+		return data;						\
+	} else {							\
+		return 0;						\
+	}								\
+}
+
+#define _F_DEF_RECV_COPY(_name_)					\
+frame_len_t frame_fn(_name_, recv_copy)(uint8_t *dst, frame_len_t len)	\
+{									\
+	frame_fn(_name_, credit_flush)();				\
+	_F_RX(_name_);							\
+	uint8_t curr_tail = rx->tail;					\
+	if (curr_tail != rx->head) {					\
+		frame_len_t curr_b_tail = rx->p_idx[curr_tail];		\
+		uint8_t next_tail =					\
+			CIRC_NEXT(rx->tail, ARRAY_SIZE(rx->p_idx));	\
+		frame_len_t next_b_tail = rx->p_idx[next_tail];		\
+		frame_len_t ct = CIRC_CNT(next_b_tail, curr_b_tail,	\
+							sizeof(rx->buf)); \
+		frame_len_t ct_to_end = CIRC_CNT_TO_END(next_b_tail,	\
+					curr_b_tail, sizeof(rx->buf));	\
+									\
+		frame_len_t cpy_ct = MIN(len, ct);			\
+		frame_len_t cpy1_len = MIN(len, ct_to_end);		\
+		frame_len_t cpy2_len = cpy_ct - cpy1_len;		\
+									\
+		memcpy(dst, rx->buf + curr_b_tail, cpy1_len);		\
+		memcpy(dst + cpy1_len, rx->buf, cpy2_len);		\
+									\
+		_F_IDX_SET(rx->p_idx[curr_tail], (curr_b_tail + cpy_ct)	\
+					& (sizeof(rx->buf) - 1));	\
+									\
+		return ct;						\
+	} else {							\
+		return 0;						\
+	}								\
+}
+
+#define _F_DEF_RECV_PEEK(_name_)					\
+frame_len_t frame_fn(_name_, recv_peek)(struct frame_seg *seg)		\
+{									\
+	frame_fn(_name_, credit_flush)();				\
+	_F_RX(_name_);							\
+	uint8_t curr_tail = rx->tail;					\
+	if (curr_tail != rx->head) {					\
+		frame_len_t curr_b_tail = rx->p_idx[curr_tail];		\
+		uint8_t next_tail =					\
+			CIRC_NEXT(curr_tail, ARRAY_SIZE(rx->p_idx));	\
+		frame_len_t next_b_tail = rx->p_idx[next_tail];		\
+		frame_len_t ct = CIRC_CNT(next_b_tail, curr_b_tail,	\
+							sizeof(rx->buf)); \
+		frame_len_t ct_to_end = CIRC_CNT_TO_END(next_b_tail,	\
+					curr_b_tail, sizeof(rx->buf));	\
+									\
+		seg[0].data = rx->buf + curr_b_tail;			\
+		seg[0].len  = ct_to_end;				\
+		seg[1].data = rx->buf;					\
+		seg[1].len  = ct - ct_to_end;				\
+									\
+		return ct;						\
+	} else {							\
+		seg[0].len = 0;						\
+		seg[1].len = 0;						\
+		return 0;						\
+	}								\
+}
+
+#define _F_DEF_RECV_NEXT(_name_)					\
+void frame_fn(_name_, recv_next)(void)					\
+{									\
+	_F_RX(_name_);							\
+	uint8_t next_tail = CIRC_NEXT(rx->tail, ARRAY_SIZE(rx->p_idx));	\
+	rx->tail = next_tail;						\
+									\
+	if (F_CREDIT_LEN) {						\
+		if (frame_var(_name_, credits_owed) < 0xff)		\
+			frame_var(_name_, credits_owed)++;		\
+		frame_fn(_name_, credit_flush)();			\
+	}								\
+}
+
+#define _F_DEF_RECV_HAVE_PKT(_name_)					\
+bool frame_fn(_name_, recv_have_pkt)(void)				\
+{									\
+	frame_fn(_name_, credit_flush)();				\
+	_F_RX(_name_);							\
+	return rx->tail != rx->head;					\
+}
+
+#define _F_DEF_RECV_CT(_name_)						\
+uint8_t frame_fn(_name_, recv_ct)(void)					\
+{									\
+	frame_fn(_name_, credit_flush)();				\
+	_F_RX(_name_);							\
+	return CIRC_CNT(rx->head, rx->tail, ARRAY_SIZE(rx->p_idx));	\
+}
+
+/** recieve: producer, modifies head **/
+/* offer the good frame in rx->buf[b_head .. b_end) to the fast handler.
+ * return: true if it was taken. */
+#define _F_DEF_RX_FAST(_name_)						\
+static inline bool frame_fn(_name_, rx_fast)(frame_len_t b_head,	\
+		frame_len_t b_end)					\
+{									\
+	_F_RX(_name_);							\
+	frame_fast_fn fn = frame_var(_name_, fast_fn);			\
+	frame_len_t n = CIRC_CNT(b_end, b_head, sizeof(rx->buf));	\
+	uint8_t f[F_FAST_LEN ? F_FAST_LEN : 1], i;			\
+	if (!fn || n > F_FAST_LEN)					\
+		return false;						\
+	for (i = 0; i < n; i++)						\
+		f[i] = rx->buf[(b_head + i) & (sizeof(rx->buf) - 1)];	\
+	return fn(f, n);						\
+}
+
+#define _F_DEF_RX_ISR(_name_, _n_)					\
+static inline void frame_fn(_name_, rx_isr_body)(void)			\
+			__attribute__((always_inline));			\
+static inline void frame_fn(_name_, rx_isr_body)(void)			\
+{									\
+	_F_RX(_name_);							\
+	static bool is_escaped;						\
+	static bool recv_started;					\
+	static bool addr_pending;					\
+	/* FRAME_COBS: bytes left in the block, its code, and a zero	\
+	 * ending it is due */						\
+	static uint8_t cobs_left;					\
+	static uint8_t cobs_code;					\
+	static bool cobs_zero;						\
+	/* some part of a frame arrived since the last flag */		\
+	static bool got_bytes;						\
+	/* bytes of rx->buf known to be free past the frame being	\
+	 * received. It can only be less than the truth: the reader	\
+	 * frees space, dropping a frame gives its bytes back. So it is	\
+	 * worked out again only once it runs out, and being 8 bit, the	\
+	 * FRAME_JUMBO sums that takes happen once per 255 bytes at most. */ \
+	static uint8_t room;						\
+	static uint16_t crc;						\
+	uint8_t status = F_RX_STATUS_GET(_n_);				\
+	uint8_t data = F_RX_BYTE_GET(_n_);				\
+									\
+	/* safe location (in rx->p_idx) to store the location of the next \
+	 * byte to write; */						\
+	uint8_t next_head = CIRC_NEXT(rx->head, ARRAY_SIZE(rx->p_idx));	\
+									\
+	/* check `status` for error conditions */			\
+	if (F_RX_STATUS_IS_ERROR(_n_, status)) {			\
+		/* frame error, data over run, parity error */		\
+		struct frame_stats *st = &frame_var(_name_, stats);	\
+		if (F_RX_STATUS_IS(_n_, status, FE))			\
+			st->rx_frame_err++;				\
+		if (F_RX_STATUS_IS(_n_, status, DOR))			\
+			st->rx_overrun++;				\
+		if (F_RX_STATUS_IS(_n_, status, UPE))			\
+			st->rx_parity++;				\
+		got_bytes = F_CREDIT_LEN;				\
+		goto drop_packet;					\
+	}								\
+									\
+	if (data == F_FLAG) {						\
+		/* prepare for start, reset packet position, etc. */	\
+		/* packet length is non-zero */				\
+		if (F_CREDIT_LEN && got_bytes) {			\
+			got_bytes = false;				\
+			frame_var(_name_, rx_frames)++;			\
+		}							\
+		recv_started = true;					\
+		is_escaped = false;					\
+		cobs_left = 0;						\
+		cobs_zero = false;					\
+		addr_pending = F_ADDR_EN;				\
+									\
+		uint16_t pkt_crc = crc;					\
+		crc = CRC_CCITT_INIT;					\
+									\
+		/* is there any data in the packet? */			\
+		frame_len_t b_head = rx->p_idx[rx->head];		\
+		frame_len_t b_end  = rx->p_idx[next_head];		\
+		if (b_head != b_end) {					\
+			/* the crc trailer must be present and check out, and \
+			 * there must be data in front of it */		\
+			if (pkt_crc != CRC_CCITT_GOOD ||		\
+				CIRC_CNT(b_end, b_head, sizeof(rx->buf)) \
+						<= FRAME_CRC_LEN) {	\
+				frame_var(_name_, stats).rx_crc++;	\
+				rx->p_idx[next_head] = b_head;		\
+				return;					\
+			}						\
+									\
+			/* strip the crc */				\
+			rx->p_idx[next_head] = (b_end - FRAME_CRC_LEN)	\
+						& (sizeof(rx->buf) - 1); \
+									\
+			if (F_FAST_LEN && frame_fn(_name_, rx_fast)(b_head, \
+						rx->p_idx[next_head])) { \
+				rx->p_idx[next_head] = b_head;		\
+				return;					\
+			}						\
+									\
+			/* Need to get some data for packet to be valid */ \
+			uint8_t next_next_head =			\
+				CIRC_NEXT(next_head, ARRAY_SIZE(rx->p_idx)); \
+			if (next_next_head == rx->tail) {		\
+				/* no space in p_idx for another packet */ \
+									\
+				/* Essentailly a packet drop, but we want \
+				 * recv_started set as this is a START_BYTE, \
+				 * after all. */			\
+				rx->p_idx[next_head] = rx->p_idx[rx->head]; \
+				frame_var(_name_, stats).rx_no_slot++;	\
+			} else {					\
+				/* advance the packet idx */		\
+				rx->head = next_head;			\
+				frame_fn(_name_, rx_hw)();		\
+									\
+				/* rx->p_idx[next_head] will be set correctly, \
+				 * update rx->p_idx[next_next_head] to be the \
+				 * same as rx->p_idx[next_head]		\
+				 */					\
+				rx->p_idx[next_next_head] =		\
+						rx->p_idx[next_head];	\
+			}						\
+		}							\
+									\
+		/* otherwise, we have zero bytes in the packet, no need to \
+		 * advance */						\
+		return;							\
+	}								\
+									\
+	if (!recv_started) {						\
+		/* ignore stuff until we get a start byte */		\
+		return;							\
+	}								\
+	got_bytes = F_CREDIT_LEN;					\
+									\
+	if (F_COBS_EN) {						\
+		if (cobs_left) {					\
+			if (!--cobs_left)				\
+				cobs_zero = cobs_code <= COBS_BLOCK_MAX; \
+		} else {						\
+			/* a code byte, standing in for the zero that	\
+			 * ended the previous block */			\
+			bool zero = cobs_zero;				\
+			cobs_code = data;				\
+			cobs_left = data - 1;				\
+			cobs_zero = !cobs_left && data <= COBS_BLOCK_MAX; \
+			if (!zero)					\
+				return;					\
+			data = 0;					\
+		}							\
+	}								\
+									\
+	if (F_ADDR_EN && addr_pending) {				\
+		/* valid addresses never need escaping */		\
+		addr_pending = false;					\
+		if (!(data & FRAME_ADDR_MCAST)				\
+				&& data != frame_var(_name_, addr)) {	\
+			/* not for us, ignore it up to the next flag */	\
+			recv_started = false;				\
+			got_bytes = false;				\
+			return;						\
+		}							\
+		crc = crc_ccitt_update(crc, data);			\
+		return;							\
+	}								\
+									\
+	if (!F_COBS_EN && data == RESET_BYTE) {				\
+		goto drop_packet;					\
+	}								\
+									\
+	if (!F_COBS_EN && data == ESC_BYTE) {				\
+		/* Possible error check: is_escaped should not already	\
+		 * be true */						\
+		is_escaped = true;					\
+		return;							\
+	}								\
+									\
+	if (is_escaped) {						\
+		/* Possible error check: is data of one of the allowed	\
+		 * escaped bytes? */					\
+		/* we previously recieved an escape char, transform data */ \
+		is_escaped = false;					\
+		data ^= ESC_MASK;					\
+									\
+	}								\
+									\
+	/* do we have another byte to write into? */			\
+	frame_len_t next_b_head = rx->p_idx[next_head];			\
+	if (!room) {							\
+		frame_len_t space = CIRC_SPACE(next_b_head,		\
+				rx->p_idx[rx->tail], sizeof(rx->buf));	\
+		room = MIN(space, 0xff);				\
+	}								\
+	if (room) {							\
+		room--;							\
+		rx->buf[next_b_head] = data;				\
+		rx->p_idx[next_head] =					\
+			(next_b_head + 1) & (sizeof(rx->buf) - 1);	\
+		crc = crc_ccitt_update(crc, data);			\
+									\
+		return;							\
+	}								\
+									\
+									\
+	/* well, shucks. we're out of space, drop the packet */		\
+	frame_var(_name_, stats).rx_no_space++;				\
+									\
+drop_packet:								\
+	recv_started = false;						\
+	is_escaped = false;						\
+	/* first byte of the sequence we are writing to; */		\
+	rx->p_idx[next_head] = rx->p_idx[rx->head];			\
+}									\
+									\
+F_RX_ISR(_name_, _n_)							\
+{									\
+	F_PROBE_ON(RX);							\
+	frame_fn(_name_, rx_isr_body)();				\
+	F_PROBE_OFF(RX);						\
+}
+
+/*** Transmision of Data ***/
+/* frame_send() is frame_sendv() of a single segment */
+#define _F_DEF_SEND_1(_name_, send, sendv)				\
+bool frame_fn(_name_, send)(const void *data, frame_len_t nbytes)	\
+{									\
+	struct frame_seg seg = { data, nbytes };			\
+	return frame_fn(_name_, sendv)(&seg, 1);			\
+}
+
+/* the TX ISR's view of a transmit ring (tx or txu), taken a byte at a time
+ * from the packet at its tail */
+#define _F_DEF_TX_LANE(_name_, what)					\
+static inline bool frame_fn(_name_, what##_empty)(void)			\
+{									\
+	_F_LANE(_name_, what);						\
+	return tx->tail == tx->head;					\
+}									\
+									\
+/* return: false once the packet has no more bytes, otherwise true with	\
+ *         the next in *data */						\
+static inline bool frame_fn(_name_, what##_byte)(uint8_t *data)		\
+{									\
+	_F_LANE(_name_, what);						\
+	frame_len_t b_tail = tx->p_idx[tx->tail];			\
+	if (b_tail == tx->p_idx[CIRC_NEXT(tx->tail, ARRAY_SIZE(tx->p_idx))]) \
+		return false;						\
+	*data = tx->buf[b_tail];					\
+	return true;							\
+}									\
+									\
+static inline void frame_fn(_name_, what##_byte_next)(void)		\
+{									\
+	_F_LANE(_name_, what);						\
+	CIRC_NEXT_EQ(tx->p_idx[tx->tail], sizeof(tx->buf));		\
+}									\
+									\
+static inline void frame_fn(_name_, what##_pkt_next)(void)		\
+{									\
+	_F_LANE(_name_, what);						\
+	tx->tail = CIRC_NEXT(tx->tail, ARRAY_SIZE(tx->p_idx));		\
+}
+
+/* call fn of the ring the TX ISR is sending from, txu if `urgent` */
+#if defined(FRAME_TX_URGENT)
+# define _F_TX_LANE(_name_, urgent, fn, args)				\
+	((urgent) ? frame_fn(_name_, txu_##fn) args			\
+		  : frame_fn(_name_, tx_##fn) args)
+# define _F_DEF_TX_LANES(_name_)					\
+	_F_DEF_STRUCT(_name_, txu, FRAME_TX_URGENT, FRAME_TX_URGENT_PKTS) \
+	_F_DEF_TX_LANE(_name_, tx)					\
+	_F_DEF_TX_LANE(_name_, txu)					\
+static inline bool frame_fn(_name_, tx_idle)(void)			\
+{									\
+	return frame_fn(_name_, tx_empty)() && frame_fn(_name_, txu_empty)(); \
+}
+#else
+# define _F_TX_LANE(_name_, urgent, fn, args)				\
+	((void)(urgent), frame_fn(_name_, tx_##fn) args)
+# define _F_DEF_TX_LANES(_name_)					\
+	_F_DEF_TX_LANE(_name_, tx)					\
+static inline bool frame_fn(_name_, tx_idle)(void)			\
+{									\
+	return frame_fn(_name_, tx_empty)();				\
+}
+#endif
+
+/** transmit: consumer of data, modifies tail **/
+#if defined(FRAME_TX_PRE_ESCAPE)
+#define _F_DEF_TX_VARS(_name_)						\
+/* crc of the packet being built with start/append */			\
+static uint16_t frame_var(_name_, tx_crc);
+
+#define _F_DEF_TX_ISR(_name_, _n_)					\
+static inline void frame_fn(_name_, tx_isr_body)(void)			\
+			__attribute__((always_inline));			\
+static inline void frame_fn(_name_, tx_isr_body)(void)			\
+{									\
+	/* tx->buf holds the packets already escaped and with their crc, all \
+	 * that is left to do is add the flags.				\
+	 *								\
+	 * Expectations:						\
+	 *    tx->p_idx[tx->tail] is the next byte to transmit		\
+	 *    tx->p_idx[next_tail] is the end of the currently		\
+	 *        transmitted packet					\
+	 */								\
+	static bool packet_started;					\
+	/* the packet going out is from txu (FRAME_TX_URGENT) */	\
+	static bool urgent;						\
+	uint8_t data;							\
+									\
+	/* Error case for UDRIE enabled when ring empty			\
+	 * no packet indexes seen */					\
+	if (frame_fn(_name_, tx_idle)()) {				\
+		packet_started = false;					\
+		F_UDRE_ISR_OFF(_n_);					\
+		frame_var(_name_, stats).tx_isr_idle++;			\
+		return;							\
+	}								\
+									\
+	/* is it a new packet? */					\
+	if (!packet_started) {						\
+		packet_started = true;					\
+		urgent = F_TX_URGENT_EN && !_F_TX_LANE(_name_, true, empty, ()); \
+		F_TX_BYTE_SEND(_n_, F_FLAG);				\
+		return;							\
+	}								\
+									\
+	if (_F_TX_LANE(_name_, urgent, byte, (&data))) {		\
+		F_TX_BYTE_SEND(_n_, data);				\
+		/* Advance byte pointer */				\
+		_F_TX_LANE(_name_, urgent, byte_next, ());		\
+		return;							\
+	}								\
+									\
+	/* no more bytes, signal packet completion */			\
+	/* advance the packet idx. */					\
+	_F_TX_LANE(_name_, urgent, pkt_next, ());			\
+									\
+	/* closes this packet, and opens the next one if there is one */ \
+	F_TX_BYTE_SEND(_n_, F_FLAG);					\
+	if (frame_fn(_name_, tx_idle)()) {				\
+		F_UDRE_ISR_OFF(_n_);					\
+		packet_started = false;					\
+		/* TXC now marks this flag having left (tx_drained) */	\
+		F_TX_DONE_CLEAR(_n_);					\
+	} else {							\
+		urgent = F_TX_URGENT_EN && !_F_TX_LANE(_name_, true, empty, ()); \
+	}								\
+}									\
+									\
+F_TX_ISR(_name_, _n_)							\
+{									\
+	F_PROBE_ON(TX);							\
+	frame_fn(_name_, tx_isr_body)();				\
+	F_PROBE_OFF(TX);						\
+}
+
+/** transmit: producer of data, modifies head **/
+/* 2 API options:
+ *  - packet building:
+ *     frame_{start,append*,done}
+ *  - full packet sending:
+ *     frame_send, frame_sendv
+ */
+/* append x, escaped (or COBS encoded), to the packet under construction in
+ * tx->p_idx[next_head].
+ * return: false if tx->buf is out of space.
+ */
+#define _F_DEF_TX_PUT(_name_, what)					\
+/* FRAME_COBS: where the code byte of the block being built is, and the	\
+ * code so far (its length + 1) */					\
+static frame_len_t frame_var(_name_, what##_cobs_code);		\
+static uint8_t frame_var(_name_, what##_cobs_run);			\
+									\
+/* FRAME_COBS: reserve the code byte of a new block */			\
+static inline bool frame_fn(_name_, what##_cobs_open)(uint8_t next_head) \
+{									\
+	_F_LANE(_name_, what);						\
+	frame_len_t b_head = tx->p_idx[next_head];			\
+	if (!CIRC_SPACE(b_head, _F_IDX_GET(tx->p_idx[tx->tail]),	\
+							sizeof(tx->buf))) \
+		return false;						\
+	frame_var(_name_, what##_cobs_code) = b_head;			\
+	frame_var(_name_, what##_cobs_run) = 1;				\
+	tx->p_idx[next_head] = CIRC_NEXT(b_head, sizeof(tx->buf));	\
+	return true;							\
+}									\
+									\
+/* FRAME_COBS: fill in the code byte of the block being built */	\
+static inline void frame_fn(_name_, what##_cobs_close)(void)		\
+{									\
+	_F_LANE(_name_, what);						\
+	tx->buf[frame_var(_name_, what##_cobs_code)] =			\
+		frame_var(_name_, what##_cobs_run);			\
+}									\
+									\
+static inline bool frame_fn(_name_, what##_put)(uint8_t next_head, uint8_t x) \
+{									\
+	_F_LANE(_name_, what);						\
+	frame_len_t b_head = tx->p_idx[next_head];			\
+	frame_len_t space = CIRC_SPACE(b_head,				\
+			_F_IDX_GET(tx->p_idx[tx->tail]), sizeof(tx->buf)); \
+									\
+	if (F_COBS_EN) {						\
+		if (x != COBS_DELIM) {					\
+			if (space < 1)					\
+				return false;				\
+			tx->buf[b_head] = x;				\
+			tx->p_idx[next_head] =				\
+				CIRC_NEXT(b_head, sizeof(tx->buf));	\
+			if (++frame_var(_name_, what##_cobs_run)	\
+					<= COBS_BLOCK_MAX)		\
+				return true;				\
+		}							\
+		/* the zero, or a full block, ends the block */		\
+		frame_fn(_name_, what##_cobs_close)();			\
+		return frame_fn(_name_, what##_cobs_open)(next_head);	\
+	}								\
+									\
+	if (x == START_BYTE || x == ESC_BYTE || x == RESET_BYTE) {	\
+		if (space < 2)						\
+			return false;					\
+		tx->buf[b_head] = ESC_BYTE;				\
+		b_head = CIRC_NEXT(b_head, sizeof(tx->buf));		\
+		x ^= ESC_MASK;						\
+	} else if (space < 1) {						\
+		return false;						\
+	}								\
+									\
+	tx->buf[b_head] = x;						\
+	tx->p_idx[next_head] = CIRC_NEXT(b_head, sizeof(tx->buf));	\
+	return true;							\
+}									\
+									\
+/* the credits are taken as the packet is queued (FRAME_CREDITS) */	\
+static inline bool frame_fn(_name_, what##_put_credits)(uint8_t next_head, \
+		uint16_t *crc)						\
+{									\
+	uint8_t c[FRAME_CREDIT_LEN], i;					\
+	frame_fn(_name_, credit_get)(c);				\
+	for (i = 0; i < sizeof(c); i++) {				\
+		*crc = crc_ccitt_update(*crc, c[i]);			\
+		if (!frame_fn(_name_, what##_put)(next_head, c[i]))	\
+			return false;					\
+	}								\
+	return true;							\
+}
+
+#define _F_DEF_START(_name_)						\
+void frame_fn(_name_, start)(void)					\
+{									\
+	_F_TX(_name_);							\
+	uint8_t next_head = CIRC_NEXT(tx->head, ARRAY_SIZE(tx->p_idx));	\
+	uint16_t crc = CRC_CCITT_INIT;					\
+	if (!CIRC_SPACE(tx->head, tx->tail, ARRAY_SIZE(tx->p_idx)))	\
+		goto drop;						\
+	tx->p_idx[next_head] = tx->p_idx[tx->head];			\
+	if (F_COBS_EN && !frame_fn(_name_, tx_cobs_open)(next_head))	\
+		goto drop;						\
+	if (F_ADDR_EN) {						\
+		uint8_t addr = frame_var(_name_, addr);			\
+		crc = crc_ccitt_update(crc, addr);			\
+		if (!frame_fn(_name_, tx_put)(next_head, addr))		\
+			goto drop;					\
+	}								\
+	if (F_CREDIT_LEN && !frame_fn(_name_, tx_put_credits)(		\
+							next_head, &crc)) \
+		goto drop;						\
+	frame_var(_name_, tx_crc) = crc;				\
+	frame_var(_name_, start_flag) = true;				\
+	return;								\
+drop:									\
+	frame_var(_name_, stats).tx_drops++;				\
+}
+
+#define _F_DEF_APPEND_U8(_name_)					\
+void frame_fn(_name_, append_u8)(uint8_t x)				\
+{									\
+	_F_TX(_name_);							\
+	if (!frame_var(_name_, start_flag))				\
+		return;							\
+									\
+	uint8_t next_head = (tx->head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+									\
+	/* Can we advance our packet bytes? if not, drop packet */	\
+	if (!frame_fn(_name_, tx_put)(next_head, x)) {			\
+		tx->p_idx[next_head] = tx->p_idx[tx->head];		\
+		frame_var(_name_, start_flag) = false;			\
+		frame_var(_name_, stats).tx_drops++;			\
+		return;							\
+	}								\
+									\
+	frame_var(_name_, tx_crc) =					\
+		crc_ccitt_update(frame_var(_name_, tx_crc), x);		\
+}
+
+#define _F_DEF_APPEND_U16(_name_)					\
+void frame_fn(_name_, append_u16)(uint16_t x)				\
+{									\
+	frame_fn(_name_, append_u8)((uint8_t)(x >> 8));			\
+	frame_fn(_name_, append_u8)((uint8_t)x & 0xFF);			\
+}
+
+#define _F_DEF_DONE(_name_, _n_)					\
+void frame_fn(_name_, done)(void)					\
+{									\
+	_F_TX(_name_);							\
+	if (!frame_var(_name_, start_flag))				\
+		return;							\
+									\
+	frame_var(_name_, start_flag) = false;				\
+									\
+	uint8_t new_head = (tx->head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+	uint16_t crc = frame_var(_name_, tx_crc);			\
+	if (!frame_fn(_name_, tx_put)(new_head, (uint8_t)(crc >> 8)) ||	\
+		!frame_fn(_name_, tx_put)(new_head, (uint8_t)crc)) {	\
+		tx->p_idx[new_head] = tx->p_idx[tx->head];		\
+		frame_var(_name_, stats).tx_drops++;			\
+		return;							\
+	}								\
+	if (F_COBS_EN)							\
+		frame_fn(_name_, tx_cobs_close)();			\
+									\
+	/* the moved tx->head indicates imediatly that new data can be	\
+	 * read */							\
+	tx->head = new_head;						\
+	F_UDRE_ISR_ON(_n_);						\
+	frame_fn(_name_, tx_hw)();					\
+	/* this frame's credits were taken after any freed space */	\
+	frame_var(_name_, credits_owed) = 0;				\
+}
+
+#define _F_DEF_SENDV(_name_, _n_, what, sendv)				\
+bool frame_fn(_name_, sendv)(const struct frame_seg *seg, uint8_t nseg)	\
+{									\
+	_F_LANE(_name_, what);						\
+	uint8_t cur_head = tx->head;					\
+	uint8_t next_head = CIRC_NEXT(cur_head, ARRAY_SIZE(tx->p_idx));	\
+	uint16_t crc = CRC_CCITT_INIT;					\
+									\
+	/* do we have space for the packet_idx? */			\
+	if (next_head == tx->tail)					\
+		goto drop;						\
+									\
+	/* build the packet past tx->head, where the ISR won't look. Running \
+	 * out of space drops the packet: it is simply never published. */ \
+	tx->p_idx[next_head] = tx->p_idx[cur_head];			\
+	if (F_COBS_EN && !frame_fn(_name_, what##_cobs_open)(next_head)) \
+		goto drop;						\
+	if (F_ADDR_EN) {						\
+		uint8_t addr = frame_var(_name_, addr);			\
+		crc = crc_ccitt_update(crc, addr);			\
+		if (!frame_fn(_name_, what##_put)(next_head, addr))	\
+			goto drop;					\
+	}								\
+	if (F_CREDIT_LEN && !frame_fn(_name_, what##_put_credits)(	\
+							next_head, &crc)) \
+		goto drop;						\
+	for (; nseg; nseg--, seg++) {					\
+		const uint8_t *d = seg->data;				\
+		frame_len_t nbytes = seg->len;				\
+		while (nbytes--) {					\
+			uint8_t x = *d++;				\
+			crc = crc_ccitt_update(crc, x);			\
+			if (!frame_fn(_name_, what##_put)(next_head, x)) \
+				goto drop;				\
+		}							\
+	}								\
+									\
+	if (!frame_fn(_name_, what##_put)(next_head, (uint8_t)(crc >> 8)) \
+		|| !frame_fn(_name_, what##_put)(next_head, (uint8_t)crc)) \
+		goto drop;						\
+	if (F_COBS_EN)							\
+		frame_fn(_name_, what##_cobs_close)();			\
+									\
+	/* advance packet idx */					\
+	tx->head = next_head;						\
+	F_UDRE_ISR_ON(_n_);						\
+	frame_var(_name_, credits_owed) = 0;				\
+	frame_fn(_name_, tx_hw)();					\
+	return true;							\
+									\
+drop:									\
+	frame_var(_name_, stats).tx_drops++;				\
+	return false;							\
+}
+
+#else /* !defined(FRAME_TX_PRE_ESCAPE) */
+#define _F_DEF_TX_VARS(_name_)
+#define _F_DEF_TX_PUT(_name_, what)
+
+#define _F_DEF_TX_ISR(_name_, _n_)					\
+static inline void frame_fn(_name_, tx_isr_body)(void)			\
+			__attribute__((always_inline));			\
+static inline void frame_fn(_name_, tx_isr_body)(void)			\
+{									\
+	/* Only enabled when we have data.				\
+	 * Bytes inseted into location indicated by next_tail.		\
+	 * Tail advanced on packet completion.				\
+	 *								\
+	 * Expectations:						\
+	 *    tx->p_idx[tx->tail] is the next byte to transmit		\
+	 *    tx->p_idx[next_tail] is the end of the currently		\
+	 *        transmitted packet					\
+	 */								\
+	static bool packet_started;					\
+	/* the ESC_BYTE for `data` has been sent, send the escaped form */ \
+	static bool is_escaped;						\
+	static uint8_t crc_sent;					\
+	static bool addr_sent;						\
+	/* credits (FRAME_CREDITS), taken as the opening flag goes out */ \
+	static uint8_t credits[FRAME_CREDIT_LEN];			\
+	static uint8_t credits_sent;					\
+	/* the packet going out is from txu (FRAME_TX_URGENT) */	\
+	static bool urgent;						\
+	static uint16_t crc;						\
+									\
+	/* Error case for UDRIE enabled when ring empty			\
+	 * no packet indexes seen */					\
+	if (frame_fn(_name_, tx_idle)()) {				\
+		packet_started = false;					\
+		F_UDRE_ISR_OFF(_n_);					\
+		frame_var(_name_, stats).tx_isr_idle++;			\
+		return;							\
+	}								\
+									\
+	/* is it a new packet? */					\
+	if (!packet_started) {						\
+		packet_started = true;					\
+		urgent = F_TX_URGENT_EN && !_F_TX_LANE(_name_, true, empty, ()); \
+		crc = CRC_CCITT_INIT;					\
+		crc_sent = 0;						\
+		addr_sent = false;					\
+		credits_sent = 0;					\
+		if (F_CREDIT_LEN)					\
+			frame_fn(_name_, credit_get)(credits);		\
+		F_TX_BYTE_SEND(_n_, START_BYTE);			\
+		return;							\
+	}								\
+									\
+	if (F_ADDR_EN && !addr_sent) {					\
+		uint8_t addr = frame_var(_name_, addr);			\
+		addr_sent = true;					\
+		crc = crc_ccitt_update(crc, addr);			\
+		F_TX_BYTE_SEND(_n_, addr);				\
+		return;							\
+	}								\
+									\
+	bool is_credit = credits_sent < F_CREDIT_LEN;			\
+	bool is_data = false;						\
+	uint8_t data;							\
+									\
+	if (is_credit) {						\
+		data = credits[credits_sent];				\
+	} else if (_F_TX_LANE(_name_, urgent, byte, (&data))) {	\
+		is_data = true;						\
+	} else if (crc_sent < FRAME_CRC_LEN) {				\
+		/* data done, crc trailer follows (high byte first) */	\
+		data = crc_sent ? (uint8_t)crc : (uint8_t)(crc >> 8);	\
+	} else {							\
+		/* no more bytes, signal packet completion */		\
+		/* advance the packet idx. */				\
+		_F_TX_LANE(_name_, urgent, pkt_next, ());		\
+		F_TX_BYTE_SEND(_n_, START_BYTE);			\
+		if (frame_fn(_name_, tx_idle)()) {			\
+			F_UDRE_ISR_OFF(_n_);				\
+			packet_started = false;				\
+			/* TXC now marks this flag having left (tx_drained) */ \
+			F_TX_DONE_CLEAR(_n_);				\
+		} else {						\
+			/* this flag also opens the next packet */	\
+			urgent = F_TX_URGENT_EN				\
+				&& !_F_TX_LANE(_name_, true, empty, ()); \
+			crc = CRC_CCITT_INIT;				\
+			crc_sent = 0;					\
+			addr_sent = false;				\
+			credits_sent = 0;				\
+			if (F_CREDIT_LEN)				\
+				frame_fn(_name_, credit_get)(credits);	\
+		}							\
+		return;							\
+	}								\
+									\
+	if (is_escaped) {						\
+		is_escaped = false;					\
+		F_TX_BYTE_SEND(_n_, data ^ ESC_MASK);			\
+	} else if (data == START_BYTE || data == ESC_BYTE		\
+			|| data == RESET_BYTE) {			\
+		is_escaped = true;					\
+		F_TX_BYTE_SEND(_n_, ESC_BYTE);				\
+		return;							\
+	} else {							\
+		F_TX_BYTE_SEND(_n_, data);				\
+	}								\
+									\
+	if (is_credit) {						\
+		crc = crc_ccitt_update(crc, data);			\
+		credits_sent++;						\
+	} else if (is_data) {						\
+		crc = crc_ccitt_update(crc, data);			\
+		/* Advance byte pointer */				\
+		_F_TX_LANE(_name_, urgent, byte_next, ());		\
+	} else {							\
+		crc_sent++;						\
+	}								\
+}									\
+									\
+F_TX_ISR(_name_, _n_)							\
+{									\
+	F_PROBE_ON(TX);							\
+	frame_fn(_name_, tx_isr_body)();				\
+	F_PROBE_OFF(TX);						\
+}
+
+/** transmit: producer of data, modifies head **/
+/* 2 API options:
+ *  - packet building:
+ *     frame_{start,append*,done}
+ *  - full packet sending:
+ *     frame_send, frame_sendv
+ */
+#define _F_DEF_START(_name_)						\
+void frame_fn(_name_, start)(void)					\
+{									\
+	_F_TX(_name_);							\
+	if (CIRC_SPACE(tx->head, tx->tail, ARRAY_SIZE(tx->p_idx))) {	\
+		frame_var(_name_, start_flag) = true;			\
+		tx->p_idx[CIRC_NEXT(tx->head,ARRAY_SIZE(tx->p_idx))] =	\
+							tx->p_idx[tx->head]; \
+	} else {							\
+		frame_var(_name_, stats).tx_drops++;			\
+	}								\
+}
+
+#define _F_DEF_APPEND_U8(_name_)					\
+void frame_fn(_name_, append_u8)(uint8_t x)				\
+{									\
+	_F_TX(_name_);							\
+	if (!frame_var(_name_, start_flag))				\
+		return;							\
+									\
+	uint8_t next_head = (tx->head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+	frame_len_t next_b_head = tx->p_idx[next_head];			\
+									\
+	/* Can we advance our packet bytes? if not, drop packet */	\
+	if (CIRC_SPACE(next_b_head, _F_IDX_GET(tx->p_idx[tx->tail]),	\
+						sizeof(tx->buf)) < 1) {	\
+		tx->p_idx[next_head] = tx->p_idx[tx->head];		\
+		frame_var(_name_, start_flag) = false;			\
+		frame_var(_name_, stats).tx_drops++;			\
+		return;							\
+	}								\
+									\
+	tx->buf[next_b_head] = x;					\
+	CIRC_NEXT_EQ(tx->p_idx[next_head], sizeof(tx->buf));		\
+}
+
+#define _F_DEF_APPEND_U16(_name_)					\
+void frame_fn(_name_, append_u16)(uint16_t x)				\
+{									\
+	_F_TX(_name_);							\
+	if (!frame_var(_name_, start_flag))				\
+		return;							\
+									\
+	uint8_t next_head = (tx->head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+	frame_len_t next_b_head = tx->p_idx[next_head];			\
+									\
+	/* Can we advance our packet bytes? if not, drop packet */	\
+	if (CIRC_SPACE(next_b_head, _F_IDX_GET(tx->p_idx[tx->tail]),	\
+						sizeof(tx->buf)) < 2) {	\
+		tx->p_idx[next_head] = tx->p_idx[tx->head];		\
+		frame_var(_name_, start_flag) = false;			\
+		frame_var(_name_, stats).tx_drops++;			\
+		return;							\
+	}								\
+									\
+	tx->buf[next_b_head] = (uint8_t)(x >> 8);			\
+	tx->buf[(next_b_head + 1) & (sizeof(tx->buf) - 1)] =		\
+						(uint8_t)x & 0xFF;	\
+									\
+	tx->p_idx[next_head] = (tx->p_idx[next_head] + 2)		\
+						& (sizeof(tx->buf) - 1); \
+}
+
+#define _F_DEF_DONE(_name_, _n_)					\
+void frame_fn(_name_, done)(void)					\
+{									\
+	_F_TX(_name_);							\
+	if (!frame_var(_name_, start_flag))				\
+		return;							\
+									\
+	uint8_t new_head = (tx->head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+	uint8_t new_next_head = (new_head + 1) & (ARRAY_SIZE(tx->p_idx) - 1); \
+									\
+	/* Set in this ordering to avoid a race (the moved tx->head indicates \
+	 * imediatly that new data can be read) */			\
+	tx->p_idx[new_next_head] = tx->p_idx[new_head];			\
+	tx->head = new_head;						\
+	F_UDRE_ISR_ON(_n_);						\
+	frame_var(_name_, start_flag) = false;				\
+	frame_fn(_name_, tx_hw)();					\
+}
+
+#define _F_DEF_SENDV(_name_, _n_, what, sendv)				\
+bool frame_fn(_name_, sendv)(const struct frame_seg *seg, uint8_t nseg)	\
+{									\
+	_F_LANE(_name_, what);						\
+	uint8_t cur_head = tx->head;					\
+	frame_len_t b_head = tx->p_idx[cur_head];			\
+	uint8_t cur_tail = tx->tail;					\
+	frame_len_t cur_b_tail = _F_IDX_GET(tx->p_idx[cur_tail]);	\
+	uint16_t nbytes = 0;						\
+	uint8_t i;							\
+									\
+	for (i = 0; i < nseg; i++)					\
+		nbytes += seg[i].len;					\
+									\
+	/* we can fill .buf up completely only in the case that the packet \
+	 * buffer has more than 1 packet (which is very likely), so use	\
+	 * the standard circ buffer managment here to keep the space open */ \
+	frame_len_t space = CIRC_SPACE(b_head, cur_b_tail, sizeof(tx->buf)); \
+									\
+	/* Can we advance our packet bytes? if not, drop packet */	\
+	if (nbytes > space) {						\
+		frame_var(_name_, stats).tx_drops++;			\
+		return false;						\
+	}								\
+									\
+	uint8_t next_head = CIRC_NEXT(cur_head, ARRAY_SIZE(tx->p_idx));	\
+	/* do we have space for the packet_idx? */			\
+	if (next_head == cur_tail) {					\
+		frame_var(_name_, stats).tx_drops++;			\
+		return false;						\
+	}								\
+									\
+	/* the space was checked above, each segment only has to be split \
+	 * where it wraps past the end of .buf (len - to_end == 0 when it \
+	 * doesn't) */							\
+	for (i = 0; i < nseg; i++) {					\
+		frame_len_t len = seg[i].len;				\
+		frame_len_t to_end =					\
+			MIN((uint16_t)sizeof(tx->buf) - b_head, len);	\
+		memcpy(tx->buf + b_head, seg[i].data, to_end);		\
+		memcpy(tx->buf, seg[i].data + to_end, len - to_end);	\
+		b_head = (b_head + len) & (sizeof(tx->buf) - 1);	\
+	}								\
+									\
+	/* advance packet length */					\
+	tx->p_idx[next_head] = b_head;					\
+									\
+	/* advance packet idx */					\
+	/* XXX: if we lock the UDRE isr prior to setting tx->head,	\
+	 * the error check in the ISR for an empty packet can be avoided. \
+	 * As we know that the currently inserted data will not have been \
+	 * processed, while without the locking if the added packet is short \
+	 * enough and the ISR is unlocked when we set tx->head, the ISR may be \
+	 * able to process the entire added packet and disable itself prior \
+	 * to us enabling it again.					\
+	 */								\
+	tx->head = next_head;						\
+									\
+	/* XXX: do we need to set					\
+	 * tx->p_idx[next_next_head] = tx->p_idx[next_head]		\
+	 * ? */								\
+	F_UDRE_ISR_ON(_n_);						\
+	frame_fn(_name_, tx_hw)();					\
+	return true;							\
+}
+
+#endif /* FRAME_TX_PRE_ESCAPE */
+
+#define _F_DEF_SEND(_name_, _n_)					\
+	_F_DEF_SENDV(_name_, _n_, tx, sendv)				\
+	_F_DEF_SEND_1(_name_, send, sendv)
+
+/* frame_send_urgent/frame_sendv_urgent (FRAME_TX_URGENT) */
+#if defined(FRAME_TX_URGENT)
+# define _F_DEF_SEND_URGENT(_name_, _n_)				\
+	_F_DEF_TX_PUT(_name_, txu)					\
+	_F_DEF_SENDV(_name_, _n_, txu, sendv_urgent)			\
+	_F_DEF_SEND_1(_name_, send_urgent, sendv_urgent)
+#else
+# define _F_DEF_SEND_URGENT(_name_, _n_)
+#endif
+
+/*** Addressing ***/
+#define _F_DEF_SET_ADDR(_name_)						\
+bool frame_fn(_name_, set_addr)(uint8_t node)				\
+{									\
+	if (node > FRAME_ADDR_NODE_MAX)					\
+		return false;						\
+	frame_var(_name_, addr) = FRAME_ADDR8(node, 0);			\
+	return true;							\
+}
+
+/*** Fast frames ***/
+#define _F_DEF_SET_FAST(_name_)						\
+void frame_fn(_name_, set_fast)(frame_fast_fn fn)			\
+{									\
+	frame_var(_name_, fast_fn) = fn;				\
+}
+
+/*** Speed ***/
+#define _F_DEF_TX_DRAINED(_name_, _n_)					\
+bool frame_fn(_name_, tx_drained)(void)					\
+{									\
+	return frame_fn(_name_, tx_idle)() && F_TX_DONE(_n_);		\
+}
+
+/*** Statistics ***/
+#define _F_DEF_STATS(_name_)						\
+uint8_t frame_fn(_name_, recv_crc_errors)(void)				\
+{									\
+	return frame_var(_name_, stats).rx_crc;				\
+}									\
+									\
+void frame_fn(_name_, stats_get)(struct frame_stats *s, bool clear)	\
+{									\
+	uint8_t sreg;							\
+	F_IRQ_SAVE(sreg);						\
+	*s = frame_var(_name_, stats);					\
+	if (clear)							\
+		memset(&frame_var(_name_, stats), 0,			\
+				sizeof(frame_var(_name_, stats)));	\
+	F_IRQ_RESTORE(sreg);						\
+}
+
+/*** Initialization ***/
+#if defined(AVR)
+# ifndef FRAME_BAUD
+#  define FRAME_BAUD 38400
+# endif
+# define BAUD FRAME_BAUD
+# include <util/setbaud.h>
+# if USE_2X
+#  define F_UCSRA_INIT(n) (1 << F_REGN_A(U2X, n))
+# else
+#  define F_UCSRA_INIT(n) 0
+# endif
+/* the FRAME_BAUD setting, for going back to it with set_ubrr */
+# define FRAME_UBRR_DEFAULT UBRR_VALUE
+# define FRAME_U2X_DEFAULT  USE_2X
+
+#define _F_DEF_INIT(_name_, _n_)					\
+void frame_fn(_name_, init)(void)					\
+{									\
+	F_PROBE_INIT();							\
+									\
+	/* Disable ISRs, recv, and trans */				\
+	F_REGN_I(UCSR, _n_, B) = 0;					\
+									\
+	/* Asyncronous, parity odd, 1 bit stop, 8 bit data */		\
+	F_REGN_I(UCSR, _n_, C) = (0 << F_REGN_I(UMSEL, _n_, 1))		\
+		| (0 << F_REGN_I(UMSEL, _n_, 0))			\
+		| (1 << F_REGN_I(UPM, _n_, 1))  | (1 << F_REGN_I(UPM, _n_, 0)) \
+		| (0 << F_REGN_A(USBS, _n_))				\
+		| (1 << F_REGN_I(UCSZ, _n_, 1)) | (1 << F_REGN_I(UCSZ, _n_, 0)); \
+									\
+	/* Baud FRAME_BAUD */						\
+	F_REGN_A(UBRR, _n_) = UBRR_VALUE;				\
+	F_REGN_I(UCSR, _n_, A) = F_UCSRA_INIT(_n_);			\
+									\
+	/* Enable RX isr, disable UDRE isr, EN recv and trans, 8 bit data */ \
+	F_REGN_I(UCSR, _n_, B) = (1 << F_REGN_A(RXCIE, _n_))		\
+		| (0 << F_REGN_A(UDRIE, _n_))				\
+		| (1 << F_REGN_A(RXEN, _n_)) | (1 << F_REGN_A(TXEN, _n_)) \
+		| (0 << F_REGN_I(UCSZ, _n_, 2));			\
+}									\
+									\
+void frame_fn(_name_, set_ubrr)(uint16_t ubrr, bool u2x)		\
+{									\
+	F_REGN_A(UBRR, _n_) = ubrr;					\
+	F_REGN_I(UCSR, _n_, A) = u2x ? (1 << F_REGN_A(U2X, _n_)) : 0;	\
+}
+#else
+/* nominal, 38400 baud from 16MHz */
+# define FRAME_UBRR_DEFAULT 25
+# define FRAME_U2X_DEFAULT  0
+
+# define _F_DEF_INIT(_name_, _n_)					\
+void frame_fn(_name_, init)(void)					\
+{									\
+}									\
+									\
+void frame_fn(_name_, set_ubrr)(uint16_t ubrr, bool u2x)		\
+{									\
+	(void)ubrr;							\
+	(void)u2x;							\
+}
+#endif
+
+#define FRAME_DEFINE(_name_, _n_, _rx_sz_, _rx_pkts_, _tx_sz_, _tx_pkts_) \
+	_F_DEF_STRUCT(_name_, rx, _rx_sz_, _rx_pkts_)			\
+	_F_DEF_STRUCT(_name_, tx, _tx_sz_, _tx_pkts_)			\
+	_F_DEF_TX_LANES(_name_)						\
+	_F_DEF_VARS(_name_)						\
+	_F_DEF_HW(_name_)						\
+	_F_DEF_CREDIT_GET(_name_)					\
+	_F_DEF_RECV_LEN(_name_)						\
+	_F_DEF_RECV_BYTE(_name_)					\
+	_F_DEF_RECV_COPY(_name_)					\
+	_F_DEF_RECV_PEEK(_name_)					\
+	_F_DEF_RECV_NEXT(_name_)					\
+	_F_DEF_RECV_HAVE_PKT(_name_)					\
+	_F_DEF_RECV_CT(_name_)						\
+	_F_DEF_RX_FAST(_name_)						\
+	_F_DEF_RX_ISR(_name_, _n_)					\
+	_F_DEF_TX_ISR(_name_, _n_)					\
+	_F_DEF_TX_PUT(_name_, tx)					\
+	_F_DEF_START(_name_)						\
+	_F_DEF_APPEND_U8(_name_)					\
+	_F_DEF_APPEND_U16(_name_)					\
+	_F_DEF_DONE(_name_, _n_)					\
+	_F_DEF_SEND(_name_, _n_)					\
+	_F_DEF_SEND_URGENT(_name_, _n_)					\
+	_F_DEF_SET_ADDR(_name_)						\
+	_F_DEF_SET_FAST(_name_)						\
+	_F_DEF_TX_DRAINED(_name_, _n_)					\
+	_F_DEF_STATS(_name_)						\
+	_F_DEF_INIT(_name_, _n_)
+
+#endif
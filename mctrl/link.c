@@ -0,0 +1,235 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "link.h"
+
+#define SEQ_NEXT(seq) (((seq) + 1) & LINK_SEQ_MASK)
+#define SEQ_DIST(from, to) (((to) - (from)) & LINK_SEQ_MASK)
+
+static void link_clear(struct link *l)
+{
+	l->va = l->vt = l->vs = l->vr = 0;
+	l->va_slot = 0;
+	l->ack_pending = false;
+	l->final = false;
+	l->rej_sent = false;
+	l->peer_busy = false;
+	l->busy_drop = false;
+}
+
+void link_init(struct link *l, link_xmit_fn xmit, uint8_t window,
+		uint16_t t1)
+{
+	l->xmit = xmit;
+	l->t1 = t1;
+	l->now = 0;
+	l->sent_at = 0;
+	if (window < 1)
+		window = 1;
+	if (window > LINK_WINDOW_MAX)
+		window = LINK_WINDOW_MAX;
+	if (window > LINK_SEQ_MASK)
+		window = LINK_SEQ_MASK;
+	l->window = window;
+	l->ua_pending = false;
+	l->busy = false;
+	link_clear(l);
+}
+
+void link_reset(struct link *l)
+{
+	uint8_t sabm = LINK_U_SABM | LINK_PF;
+	link_clear(l);
+	l->xmit(&sabm, 1);
+}
+
+static uint8_t link_slot(struct link *l, uint8_t seq)
+{
+	uint8_t s = l->va_slot + SEQ_DIST(l->va, seq);
+	if (s >= l->window)
+		s -= l->window;
+	return s;
+}
+
+bool link_can_send(struct link *l)
+{
+	return SEQ_DIST(l->va, l->vs) < l->window;
+}
+
+bool link_send(struct link *l, const void *data, uint8_t len)
+{
+	if (!link_can_send(l) || len > LINK_INFO_MAX)
+		return false;
+
+	uint8_t s = link_slot(l, l->vs);
+	memcpy(&l->slot[s][1], data, len);
+	l->len[s] = len + 1;
+	l->vs = SEQ_NEXT(l->vs);
+
+	link_poll(l, l->now);
+	return true;
+}
+
+/* N(R) acks every frame before it. */
+static void link_ack(struct link *l, uint8_t nr)
+{
+	/* ignore N(R)s that ack frames we haven't sent */
+	if (SEQ_DIST(l->va, nr) > SEQ_DIST(l->va, l->vs))
+		return;
+
+	if (nr != l->va) {
+		/* the oldest unacked frame changed, restart its timer */
+		l->va_slot = link_slot(l, nr);
+		l->va = nr;
+		l->sent_at = l->now;
+	}
+
+	/* frames queued for retransmission may have just been acked */
+	if (SEQ_DIST(l->va, l->vt) > SEQ_DIST(l->va, l->vs))
+		l->vt = l->va;
+}
+
+/* RR, or RNR while busy, or REJ for what was dropped while busy */
+static void link_send_s(struct link *l)
+{
+	uint8_t type = l->busy ? LINK_S_RNR
+			: l->busy_drop ? LINK_S_REJ : LINK_S_RR;
+	uint8_t ctrl = LINK_CTRL_S(l->vr, type);
+	if (l->final)
+		ctrl |= LINK_PF;
+	if (l->xmit(&ctrl, 1)) {
+		l->ack_pending = false;
+		l->final = false;
+		if (type == LINK_S_REJ) {
+			l->busy_drop = false;
+			l->rej_sent = true;
+		}
+	}
+}
+
+void link_set_busy(struct link *l, bool busy)
+{
+	if (busy == l->busy)
+		return;
+	l->busy = busy;
+	/* tell the peer, with RNR now or with RR/REJ once no longer busy */
+	l->ack_pending = true;
+}
+
+bool link_recv(struct link *l, uint8_t ctrl)
+{
+	if (LINK_IS_U(ctrl)) {
+		switch (ctrl & ~LINK_PF) {
+		case LINK_U_SABM:
+		case LINK_U_DISC:
+			link_clear(l);
+			l->ua_pending = true;
+			link_poll(l, l->now);
+			break;
+		case LINK_U_UA:
+		default:
+			break;
+		}
+		return false;
+	}
+
+	link_ack(l, LINK_NR(ctrl));
+
+	if (ctrl & LINK_PF)
+		l->final = true;
+
+	if (LINK_IS_S(ctrl)) {
+		switch (LINK_S_TYPE(ctrl)) {
+		case LINK_S_RNR:
+			/* time the poll from here */
+			if (!l->peer_busy)
+				l->sent_at = l->now;
+			l->peer_busy = true;
+			break;
+		case LINK_S_REJ:
+		case LINK_S_SREJ:
+			/* go back to N(R) (now va) and resend from there */
+			l->vt = l->va;
+			l->sent_at = l->now;
+			/* fall through */
+		case LINK_S_RR:
+			l->peer_busy = false;
+			break;
+		}
+		return false;
+	}
+
+	/* I frame */
+	if (l->busy) {
+		/* no room, it is sent again after the REJ */
+		if (LINK_NS(ctrl) == l->vr)
+			l->busy_drop = true;
+		l->ack_pending = true;
+		return false;
+	}
+	if (LINK_NS(ctrl) != l->vr) {
+		/* out of sequence, ask for a retransmit once */
+		if (!l->rej_sent) {
+			uint8_t rej = LINK_CTRL_S(l->vr, LINK_S_REJ);
+			if (l->xmit(&rej, 1))
+				l->rej_sent = true;
+		}
+		return false;
+	}
+
+	l->vr = SEQ_NEXT(l->vr);
+	l->rej_sent = false;
+	l->ack_pending = true;
+	return true;
+}
+
+void link_refuse(struct link *l)
+{
+	l->vr = (l->vr - 1) & LINK_SEQ_MASK;
+	l->busy = true;
+	l->busy_drop = true;
+	l->ack_pending = true;
+}
+
+void link_poll(struct link *l, uint16_t now)
+{
+	l->now = now;
+
+	if (l->ua_pending) {
+		uint8_t ua = LINK_U_UA | LINK_PF;
+		if (!l->xmit(&ua, 1))
+			return;
+		l->ua_pending = false;
+	}
+
+	if (l->peer_busy) {
+		/* the RR ending it may have been lost, ask with a poll */
+		if ((uint16_t)(now - l->sent_at) >= l->t1) {
+			uint8_t rr = LINK_CTRL_S(l->vr, LINK_S_RR) | LINK_PF;
+			if (l->xmit(&rr, 1)) {
+				l->sent_at = now;
+				l->ack_pending = false;
+			}
+		}
+	} else if (l->va != l->vs && l->vt != l->va &&
+			(uint16_t)(now - l->sent_at) >= l->t1) {
+		/* retransmit timeout: go back to the oldest unacked frame */
+		l->vt = l->va;
+	}
+
+	while (l->vt != l->vs && !l->peer_busy) {
+		uint8_t s = link_slot(l, l->vt);
+		l->slot[s][0] = LINK_CTRL_I(l->vr, l->vt);
+		if (!l->xmit(l->slot[s], l->len[s]))
+			break;
+
+		if (l->vt == l->va)
+			l->sent_at = now;
+		l->vt = SEQ_NEXT(l->vt);
+		l->ack_pending = false;
+	}
+
+	if (l->ack_pending || l->final)
+		link_send_s(l);
+}
@@ -0,0 +1,146 @@
+#ifndef LINK_H_
+#define LINK_H_ 1
+#include <stdint.h>
+#include <stdbool.h>
+
+/* HDLC style reliable delivery on top of the framing layer.
+ *
+ * The first byte of every frame handled by the link is the HDLC control
+ * byte (see frame_gen.h):
+ *
+ * Frame 7 6 5 4   3 2 1 0
+ * I     N(R)  p   N(S)  0
+ * S     N(R)  p/f S S 0 1
+ * U     M M M p/f M M 1 1
+ *
+ * I frames carry data and are numbered mod 8. Up to `window` (at most 7)
+ * I frames may be outstanding at once. Every I and S frame carries N(R),
+ * the cumulative ack of all I frames received in sequence. A frame received
+ * out of sequence is discarded and answered (once) with REJ, upon which the
+ * sender goes back and retransmits everything from N(R) on. Frames still
+ * unacked after `t1` ticks are likewise all retransmitted.
+ *
+ * When there is no outgoing I frame for the ack to ride on, it is sent as an
+ * RR from link_poll().
+ *
+ * A receiver with no room for more data says so with link_set_busy(), or
+ * link_refuse() for data link_recv() has just handed it: I frames are then
+ * dropped unacked and answered with RNR, which stops the sender. Once it is
+ * no longer busy, RR (or REJ, if something was dropped) gets the sender
+ * going again. A stopped sender polls the receiver with RR(P) every `t1` in
+ * case that was lost.
+ *
+ * SABM (answered with UA) resets the sequence numbers on both ends.
+ *
+ * The same code is used by the firmware (over frame_send/frame_recv_*) and
+ * by the host tools in pc/ (over their frame_send/frame_recv).
+ */
+
+/* max number of data bytes in an I frame */
+#ifndef LINK_INFO_MAX
+# define LINK_INFO_MAX 24
+#endif
+
+/* max window, RAM use is LINK_WINDOW_MAX * (LINK_INFO_MAX + 2) */
+#ifndef LINK_WINDOW_MAX
+# define LINK_WINDOW_MAX 4
+#endif
+
+#define LINK_SEQ_MASK 7
+
+/* control byte composition */
+#define LINK_PF 0x10
+#define LINK_CTRL_I(nr, ns) ((uint8_t)(((nr) << 5) | ((ns) << 1)))
+#define LINK_CTRL_S(nr, s)  ((uint8_t)(((nr) << 5) | ((s) << 2) | 0x01))
+
+#define LINK_IS_I(ctrl) (((ctrl) & 0x01) == 0)
+#define LINK_IS_S(ctrl) (((ctrl) & 0x03) == 0x01)
+#define LINK_IS_U(ctrl) (((ctrl) & 0x03) == 0x03)
+#define LINK_NR(ctrl)   ((uint8_t)(ctrl) >> 5)
+#define LINK_NS(ctrl)   (((ctrl) >> 1) & LINK_SEQ_MASK)
+#define LINK_S_TYPE(ctrl) (((ctrl) >> 2) & 0x03)
+
+/* S frame types */
+#define LINK_S_RR   0
+#define LINK_S_RNR  1
+#define LINK_S_REJ  2
+#define LINK_S_SREJ 3
+
+/* U frames (without the p/f bit) */
+#define LINK_U_SABM 0x2f
+#define LINK_U_UA   0x63
+#define LINK_U_DISC 0x43
+/* XID is left to the speed negotiation, see baud.h */
+#define LINK_U_XID  0xaf
+/* UI (unnumbered information) carries the fragments of frag.h */
+#define LINK_U_UI   0x03
+
+/* hands a complete frame (control byte first) to the framing layer.
+ * return: false if it could not be queued. */
+typedef bool (*link_xmit_fn)(const void *frame, uint8_t len);
+
+struct link {
+	link_xmit_fn xmit;
+	uint16_t t1;      /* retransmit timeout, in link_poll() ticks */
+	uint16_t now;     /* time of the last link_poll() */
+	uint16_t sent_at; /* time the oldest unacked frame was last sent */
+	uint8_t window;
+
+	uint8_t va;       /* oldest unacked N(S) */
+	uint8_t vt;       /* next N(S) to (re)transmit */
+	uint8_t vs;       /* next N(S) to assign */
+	uint8_t vr;       /* next N(S) expected from the peer */
+	uint8_t va_slot;  /* slot holding frame va */
+
+	bool ack_pending; /* the peer needs to be told about vr */
+	bool final;       /* the peer polled, answer with F set */
+	bool rej_sent;    /* REJ for vr is outstanding */
+	bool peer_busy;   /* peer sent RNR */
+	bool ua_pending;  /* peer sent SABM/DISC, answer with UA */
+	bool busy;        /* we take no data, answer with RNR */
+	bool busy_drop;   /* an I frame was dropped while busy */
+
+	uint8_t len[LINK_WINDOW_MAX];
+	/* unacked frames, control byte first */
+	uint8_t slot[LINK_WINDOW_MAX][1 + LINK_INFO_MAX];
+};
+
+/* window: max outstanding I frames (1 .. LINK_WINDOW_MAX, at most 7).
+ * t1: retransmit timeout, in the units of the `now` passed to link_poll().
+ */
+void link_init(struct link *l, link_xmit_fn xmit, uint8_t window,
+		uint16_t t1);
+
+/* drop everything outstanding, zero the sequence numbers and ask the
+ * peer to do the same (SABM). */
+void link_reset(struct link *l);
+
+/* queue data for reliable delivery, len <= LINK_INFO_MAX.
+ * return: false if the window is full (or len is too large).
+ */
+bool link_send(struct link *l, const void *data, uint8_t len);
+
+/* return: true if there is room in the window for another link_send() */
+bool link_can_send(struct link *l);
+
+/* busy: true while the user can take no more data (see above). Cheap
+ * when unchanged, may be called before every link_recv(). */
+void link_set_busy(struct link *l, bool busy);
+
+/* feed the control byte of a received frame to the link.
+ * return: true if the frame is an in-sequence I frame, in which case the
+ *         bytes following the control byte are data for the user. For any
+ *         other frame the caller should just drop it.
+ */
+bool link_recv(struct link *l, uint8_t ctrl);
+
+/* give back the data link_recv() has just returned true for, which the user
+ * has no room for: it is dropped unacked, to be sent again, and the link is
+ * busy until link_set_busy(l, false). */
+void link_refuse(struct link *l);
+
+/* run timers, send acks and (re)transmit queued frames. Call regularly,
+ * `now` is a free running tick count (wraps). */
+void link_poll(struct link *l, uint16_t now);
+
+#endif
@@ -1,40 +1,189 @@
 #include <string.h>
-#include <util/delay.h>
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
 #include "error_led.h"
 #include "frame_async.h"
-#include "motor_shb.h"
+#include "chan.h"
+#include "rpc.h"
+#include "ctl.h"
+#include "tick.h"
+#include "baud.h"
+#include "frag.h"
+#include "link.h"
 #include "common.h"
+#include "ds/pool.h"
+
+/* ms per tick of the baud and frag timeouts */
+#define SLOW_TICK_MS 70
+/* how long the led stays lit after a frame */
+#define LED_MS 20
+
+static void echo_packet(uint8_t chan, const struct frame_seg *seg)
+{
+	chan_sendv(chan, seg, 2);
+}
+
+/* CHAN_LINK carries the speed negotiation (XID) and a reliable link whose
+ * data is echoed back over it. Data the link has no room to echo is refused,
+ * it comes again once the window has room. So is an I frame with more than
+ * LINK_INFO_MAX bytes, which never fits: those are counted and reported on
+ * the console, a peer with a larger info size is stuck otherwise. */
+static struct link lnk;
+static uint16_t link_too_long, link_too_long_told;
+
+static bool link_xmit(const void *frame, uint8_t len)
+{
+	return chan_send(CHAN_LINK, frame, len);
+}
+
+static void link_packet(uint8_t chan, const struct frame_seg *seg)
+{
+	uint8_t f[1 + LINK_INFO_MAX];
+	frame_len_t len = 0, i;
+	uint8_t s;
+
+	if (baud_recv(seg))
+		return;
+
+	for (s = 0; s < 2; s++)
+		for (i = 0; i < seg[s].len; i++, len++)
+			if (len < sizeof(f))
+				f[len] = seg[s].data[i];
+	/* the control byte of a frame too long still acks */
+	if (!len || !link_recv(&lnk, f[0]))
+		return;
+
+	if (len > sizeof(f)) {
+		link_too_long++;
+		link_refuse(&lnk);
+	} else if (!link_send(&lnk, f + 1, len - 1)) {
+		link_refuse(&lnk);
+	}
+}
+
+/* fragmented messages are echoed whole once reassembled, messages up to
+ * FRAG_ECHO_MAX bytes. A message is reassembled in a block of the frag pool
+ * which is handed to ftx as it is, while the next is reassembled in the
+ * other block. */
+#ifndef FRAG_ECHO_MAX
+# define FRAG_ECHO_MAX 128
+#endif
+POOL_DECLARE(frag, 2, FRAG_ECHO_MAX)
+POOL_DEFINE(frag, 2, FRAG_ECHO_MAX)
+static struct frag_rx frx;
+static struct frag_tx ftx;
+/* the block ftx is sending, NULL if none */
+static uint8_t *frag_out;
+/* messages reassembled while the previous one was still going out, and
+ * how many of them have been reported on the console */
+static uint16_t frag_busy, frag_busy_told;
+
+static bool frag_xmit(const void *frame, uint8_t len)
+{
+	return chan_send(CHAN_BULK, frame, len);
+}
+
+static void frag_packet(uint8_t chan, const struct frame_seg *seg)
+{
+	uint8_t f[FRAG_HDR_LEN + FRAG_DATA_MAX];
+	frame_len_t len = 0, i;
+	uint8_t s;
+
+	for (s = 0; s < 2; s++)
+		for (i = 0; i < seg[s].len; i++, len++)
+			if (len < sizeof(f))
+				f[len] = seg[s].data[i];
+	if (len > sizeof(f) || !FRAG_IS(f[0]))
+		return;
+
+	uint16_t n = frag_recv(&frx, f, len);
+	if (!n)
+		return;
+
+	uint8_t *next = frag_out ? NULL : pool_alloc(frag)();
+	if (!next) {
+		/* lost, the next message overwrites it */
+		frag_busy++;
+		return;
+	}
+	frag_out = frx.buf;
+	frag_send(&ftx, frag_out, n);
+	frag_rx_set_buf(&frx, next);
+}
 
 __attribute__((noreturn))
 void main(void)
 {
+	/* idle slow ticks, says hello when it wraps */
 	static uint8_t ct;
+	static uint16_t ticks;
+	static uint32_t slow_last, led_off;
+	static bool led_lit;
 	cli();
 	frame_init();
+	chan_init();
+	ctl_init();
+	chan_set_recv(CHAN_LINK, link_packet);
+	chan_set_recv(CHAN_CONSOLE, echo_packet);
+	chan_set_recv(CHAN_RPC, rpc_recv);
+	chan_set_recv(CHAN_TELEM, echo_packet);
+	chan_set_recv(CHAN_BULK, frag_packet);
+	baud_init(15);
+	frag_rx_init(&frx, pool_alloc(frag)(), FRAG_ECHO_MAX, 15);
+	frag_tx_init(&ftx, frag_xmit, FRAG_DATA_MAX);
+	/* t1 of 3 slow ticks, 210 ms */
+	link_init(&lnk, link_xmit, LINK_WINDOW_MAX, 3);
 	led_init();
+	tick_init();
 	sei();
 	for(;;) {
-		uint8_t buf[16];
-		uint8_t len = frame_recv_copy(buf, sizeof(buf));
-		if (len) {
-			led_flash(5);
+		/* nothing in here waits, one pass is well under a tick */
+		bool got = chan_poll();
+		uint32_t now = tick_ms();
+
+		ctl_poll(now);
+		baud_poll(ticks);
+		frag_rx_poll(&frx, ticks);
+		if (link_can_send(&lnk))
+			link_set_busy(&lnk, false);
+		link_poll(&lnk, ticks);
+		if (frag_tx_poll(&ftx) && frag_out) {
+			pool_unref(frag)(frag_out);
+			frag_out = NULL;
+		}
+		if (frag_busy != frag_busy_told) {
+			const char busy_str[] = "frag: dropped, echo busy\n";
+			if (chan_send(CHAN_CONSOLE, busy_str, strlen(busy_str)))
+				frag_busy_told = frag_busy;
+		}
+		if (link_too_long != link_too_long_told) {
+			const char long_str[] = "link: I frame too long\n";
+			if (chan_send(CHAN_CONSOLE, long_str, strlen(long_str)))
+				link_too_long_told = link_too_long;
+		}
+
+		if (got) {
+			led_set(true);
+			led_lit = true;
+			led_off = now + LED_MS;
 			ct = 0;
-			frame_send(buf, MIN(len, sizeof(buf)));
-			frame_recv_next();
-		} else {
+		} else if (led_lit && (int32_t)(now - led_off) >= 0) {
+			led_set(false);
+			led_lit = false;
+		}
+
+		if (now - slow_last >= SLOW_TICK_MS) {
+			slow_last += SLOW_TICK_MS;
+			ticks++;
 			ct++;
 			if (ct == 0) {
 				ct++;
-				led_flash(3);
-				const char rdy_str[] = "hello";
-				frame_send(rdy_str, strlen(rdy_str));
+				const char rdy_str[] = "hello\n";
+				chan_send(CHAN_CONSOLE, rdy_str,
+						strlen(rdy_str));
 			}
-			_delay_ms(70);
 		}
-
 	}
 }
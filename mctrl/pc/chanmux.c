@@ -0,0 +1,301 @@
+/* Split the mctrl host link into its channels.
+ *
+ * usage: chanmux [-C] [-a node] [-k] [-d dir] tty
+ *
+ * Creates a SOCK_SEQPACKET unix socket in dir (. by default) for each
+ * channel of ../chan.h: link, console, rpc, telem, bulk and fast. Each packet a
+ * client writes to one goes to the board as a frame on that channel, and
+ * each frame from the board goes to every client connected to its channel,
+ * without the channel byte. A client that doesn't keep up loses frames
+ * rather than holding up the others. For example
+ *	socat - UNIX-CONNECT:console,type=5
+ * shows the board's debug output. -C talks COBS, for a board built with
+ * FRAME_COBS. -a talks to `node` of a board built with FRAME_ADDR, -k
+ * keeps to the credits of one built with FRAME_CREDITS: while the board has
+ * no room for a client's packet, it is held and no more are taken from the
+ * clients.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "../proto.h"
+#include "frame_buf.h"
+#include "serial.h"
+
+#define CLIENTS_MAX 16
+/* largest frame from the board, and packet to it (more than 255 bytes
+ * needs FRAME_JUMBO on the board) */
+#define FRAME_MAX 1024
+
+static const char *const chan_names[CHAN_COUNT] = {
+	[CHAN_LINK]    = "link",
+	[CHAN_CONSOLE] = "console",
+	[CHAN_RPC]     = "rpc",
+	[CHAN_TELEM]   = "telem",
+	[CHAN_BULK]    = "bulk",
+	[CHAN_FAST]    = "fast",
+};
+
+struct mux {
+	int tty;
+	int listen[CHAN_COUNT];
+	char path[CHAN_COUNT][sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct {
+		int fd;
+		uint8_t chan;
+		bool dead; /* to be dropped once the poll results are used */
+	} client[CLIENTS_MAX];
+	unsigned nclient;
+
+	/* a packet waiting for the board's credits (-k) */
+	uint8_t held[1 + FRAME_MAX];
+	size_t held_len;
+
+	unsigned long unknown; /* frames on channels we have no socket for */
+	unsigned long lost;    /* frames a client had no room for */
+	unsigned long too_big; /* packets larger than the board's rx ring */
+};
+
+static volatile sig_atomic_t done;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	done = 1;
+}
+
+/* drop the dead clients; moves the others, so only between polls */
+static void client_reap(struct mux *m)
+{
+	unsigned i;
+
+	for (i = m->nclient; i--; ) {
+		if (!m->client[i].dead)
+			continue;
+		close(m->client[i].fd);
+		m->client[i] = m->client[--m->nclient];
+	}
+}
+
+static void tty_frame(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct mux *m = ctx;
+	unsigned i;
+
+	if (!len || frame[0] >= CHAN_COUNT) {
+		m->unknown++;
+		return;
+	}
+
+	for (i = 0; i < m->nclient; i++) {
+		if (m->client[i].chan != frame[0] || m->client[i].dead)
+			continue;
+		if (send(m->client[i].fd, frame + 1, len - 1,
+					MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			m->lost++;
+		else
+			m->client[i].dead = true;
+	}
+}
+
+/* send pkt to the board, or hold it until the board has the credits.
+ * return: 0, or -1 with errno set */
+static int mux_write(struct mux *m, const uint8_t *pkt, size_t len)
+{
+	if (frame_write(m->tty, pkt, len) >= 0)
+		return 0;
+	if (errno == EAGAIN) {
+		memcpy(m->held, pkt, len);
+		m->held_len = len;
+		return 0;
+	}
+	if (errno == EMSGSIZE) {
+		m->too_big++;
+		return 0;
+	}
+	return -1;
+}
+
+/* return: 0, or -1 with errno set */
+static int mux_listen(struct mux *m, const char *dir)
+{
+	uint8_t c;
+
+	if (mkdir(dir, 0777) && errno != EEXIST)
+		return -1;
+
+	for (c = 0; c < CHAN_COUNT; c++) {
+		struct sockaddr_un sa = { .sun_family = AF_UNIX };
+		int n = snprintf(m->path[c], sizeof(m->path[c]), "%s/%s", dir,
+				chan_names[c]);
+		if (n < 0 || (size_t)n >= sizeof(m->path[c])) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		strcpy(sa.sun_path, m->path[c]);
+		unlink(m->path[c]);
+
+		m->listen[c] = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+		if (m->listen[c] < 0
+				|| bind(m->listen[c], (struct sockaddr *)&sa,
+					sizeof(sa))
+				|| listen(m->listen[c], CLIENTS_MAX))
+			return -1;
+	}
+	return 0;
+}
+
+static int mux_run(struct mux *m)
+{
+	struct pollfd p[1 + CHAN_COUNT + CLIENTS_MAX];
+	uint8_t dec_buf[FRAME_MAX + FRAME_CRC_LEN];
+	struct frame_dec dec;
+	unsigned i;
+
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	while (!done) {
+		unsigned n = 0;
+		/* clients wait while a packet is held */
+		bool clients = !m->held_len;
+		p[n++] = (struct pollfd){ .fd = m->tty, .events = POLLIN };
+		for (i = 0; i < CHAN_COUNT; i++)
+			p[n++] = (struct pollfd){ .fd = m->listen[i],
+							.events = POLLIN };
+		for (i = 0; clients && i < m->nclient; i++)
+			p[n++] = (struct pollfd){ .fd = m->client[i].fd,
+							.events = POLLIN };
+
+		if (poll(p, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (p[0].revents) {
+			ssize_t r = frame_dec_read(&dec, m->tty, tty_frame, m);
+			if (!r) {
+				errno = EIO;
+				return -1;
+			}
+			if (r < 0 && errno != EAGAIN && errno != EINTR)
+				return -1;
+		}
+
+		/* the board's credits come with its frames */
+		if (m->held_len) {
+			size_t len = m->held_len;
+			m->held_len = 0;
+			if (mux_write(m, m->held, len))
+				return -1;
+		}
+
+		/* p[] follows m->client until client_reap() */
+		for (i = 0; clients && !m->held_len && i < m->nclient; i++) {
+			uint8_t pkt[1 + FRAME_MAX];
+			if (!p[1 + CHAN_COUNT + i].revents || m->client[i].dead)
+				continue;
+
+			ssize_t r = recv(m->client[i].fd, pkt + 1, FRAME_MAX,
+					MSG_TRUNC | MSG_DONTWAIT);
+			if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK
+						|| errno == EINTR))
+				continue;
+			if (r <= 0) {
+				m->client[i].dead = true;
+				continue;
+			}
+			if (r > FRAME_MAX)
+				continue;
+			pkt[0] = m->client[i].chan;
+			if (mux_write(m, pkt, 1 + r))
+				return -1;
+		}
+		client_reap(m);
+
+		for (i = 0; i < CHAN_COUNT; i++) {
+			if (!p[1 + i].revents)
+				continue;
+			int fd = accept(m->listen[i], NULL, NULL);
+			if (fd < 0)
+				continue;
+			if (m->nclient == CLIENTS_MAX) {
+				close(fd);
+				continue;
+			}
+			m->client[m->nclient].fd = fd;
+			m->client[m->nclient].chan = i;
+			m->client[m->nclient].dead = false;
+			m->nclient++;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct mux m;
+	const char *dir = ".";
+	int opt, ret = 0;
+	uint8_t c;
+
+	while ((opt = getopt(argc, argv, "Ca:kd:")) != -1) {
+		switch (opt) {
+		case 'C': frame_set_codec(FRAME_CODEC_COBS); break;
+		case 'a':
+			if (serial_set_node(optarg))
+				goto usage;
+			break;
+		case 'k':
+			frame_set_credits(CREDIT_BOARD_SLOTS,
+					CREDIT_BOARD_BYTES);
+			break;
+		case 'd': dir = optarg; break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (argc - optind != 1)
+		goto usage;
+
+	m.tty = serial_open(argv[optind]);
+	if (m.tty < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	if (mux_listen(&m, dir) || mux_run(&m)) {
+		fprintf(stderr, "chanmux: %s\n", strerror(errno));
+		ret = 1;
+	}
+
+	for (c = 0; c < CHAN_COUNT; c++)
+		if (m.path[c][0])
+			unlink(m.path[c]);
+	if (m.unknown || m.lost || m.too_big)
+		fprintf(stderr, "%lu frames on unknown channels, %lu lost, "
+				"%lu packets too big for the board\n",
+				m.unknown, m.lost, m.too_big);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-C] [-a node] [-k] [-d dir] tty\n",
+			argv[0]);
+	return 2;
+}
@@ -0,0 +1,62 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../proto.h"
+#include "credit.h"
+
+void credit_init(struct credit *c, uint8_t slots, uint8_t bytes)
+{
+	memset(c, 0, sizeof(*c));
+	c->slots = slots;
+	c->bytes = bytes;
+	c->most = bytes;
+}
+
+bool credit_can_send(const struct credit *c, size_t len)
+{
+	uint8_t in_flight = c->sent - c->seen;
+	return in_flight < c->slots
+		&& c->in_bytes + len + FRAME_CRC_LEN <= c->bytes;
+}
+
+bool credit_fits(const struct credit *c, size_t len)
+{
+	return len + FRAME_CRC_LEN <= c->most;
+}
+
+void credit_sent(struct credit *c, size_t len)
+{
+	size_t cost = len + FRAME_CRC_LEN;
+	if (cost > 255)
+		cost = 255;
+	c->cost[c->sent++] = cost;
+	c->in_bytes += cost;
+}
+
+size_t credit_recv(struct credit *c, const uint8_t *frame, size_t len)
+{
+	if (len < FRAME_CREDIT_LEN)
+		return 0;
+
+	uint8_t rx_frames = frame[0];
+	uint8_t in_flight = c->sent - c->seen;
+	uint8_t newly_seen = rx_frames - c->seen;
+
+	if (newly_seen > in_flight) {
+		/* out of step (one end restarted, or line noise looked like
+		 * a frame), start over with nothing in flight */
+		c->sent = rx_frames;
+		c->in_bytes = 0;
+	} else {
+		while (c->seen != rx_frames)
+			c->in_bytes -= c->cost[c->seen++];
+	}
+
+	c->seen = rx_frames;
+	c->slots = frame[1];
+	c->bytes = frame[2];
+	if (c->bytes > c->most)
+		c->most = c->bytes;
+	return FRAME_CREDIT_LEN;
+}
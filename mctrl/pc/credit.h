@@ -0,0 +1,56 @@
+#ifndef CREDIT_H_
+#define CREDIT_H_ 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../proto.h"
+
+/* Sender side of the credit based flow control of a board built with
+ * FRAME_CREDITS (see ../frame_gen.h).
+ *
+ * Every frame from the board says how many frames it has seen from us
+ * (rx_frames) and how much room was left in its receive rings after them.
+ * The frames sent since are still on their way, so they are charged against
+ * that room before another one is allowed out. Frames the board drops free
+ * their space like any other, so nothing leaks.
+ */
+/* what to start with against a board with frame_async.c's rings (8
+ * packets, 32 bytes in rx), until it says otherwise. The RX ISR keeps a
+ * slot free past the frame being received. */
+#define CREDIT_BOARD_SLOTS 6
+#define CREDIT_BOARD_BYTES 31
+
+struct credit {
+	uint8_t sent;      /* frames sent, mod 256 */
+	uint8_t seen;      /* the board's rx_frames as of the last update */
+	uint8_t slots;     /* free packet slots after `seen` frames */
+	uint8_t bytes;     /* free bytes after `seen` frames */
+	uint8_t most;      /* most free bytes ever, about the size of rx.buf */
+	uint16_t in_bytes; /* bytes charged for frames seen .. sent */
+	uint8_t cost[256]; /* bytes charged for each frame, by number */
+};
+
+/* slots, bytes: credit to start with, before the board has said anything.
+ * 0 to wait for the board's first frame. */
+void credit_init(struct credit *c, uint8_t slots, uint8_t bytes);
+
+/* return: true if a frame with len bytes of data may be sent now. */
+bool credit_can_send(const struct credit *c, size_t len);
+
+/* return: false if a frame with len bytes of data is more than the board
+ *         has ever had room for, so waiting won't help. */
+bool credit_fits(const struct credit *c, size_t len);
+
+/* account for a frame with len bytes of data having been sent */
+void credit_sent(struct credit *c, size_t len);
+
+/* take the credits from the front of a frame received from the board (after
+ * addr, if any).
+ * return: number of bytes of credits at the front of frame, the data
+ *         follows. 0 if the frame is too short to hold any.
+ */
+size_t credit_recv(struct credit *c, const uint8_t *frame, size_t len);
+
+#endif
@@ -5,24 +5,34 @@
 #include <errno.h>
 
 #include "../proto.h"
+#include "crc16.h"
+
+static void put_escaped(FILE *out, uint8_t c)
+{
+	if (c == START_BYTE || c == ESC_BYTE || c == RESET_BYTE) {
+		fputc(ESC_BYTE, out);
+		fputc(ESC_MASK ^ c, out);
+	} else {
+		fputc(c, out);
+	}
+}
 
 ssize_t frame_send(FILE *out, void *data, size_t nbytes)
 {
-	char *d;
-	char *end;
+	uint8_t *d;
+	uint8_t *end;
+	uint16_t crc = CRC_CCITT_INIT;
 
 	fputc(START_BYTE, out);
 
 	for(d = data, end = d + nbytes; d < end; d++) {
-		char c = *d;
-		if (c == START_BYTE || c == ESC_BYTE || c == RESET_BYTE) {
-			fputc(ESC_BYTE, out);
-			fputc(ESC_MASK ^ c, out);
-		} else {
-			fputc(c, out);
-		}
+		crc = crc_ccitt_update(crc, *d);
+		put_escaped(out, *d);
 	}
 
+	put_escaped(out, crc >> 8);
+	put_escaped(out, crc & 0xff);
+
 	fputc(START_BYTE, out);
 
 	fflush(out);
@@ -51,10 +61,17 @@ ssize_t frame_recv(FILE *in, void *vbuf, size_t nbytes)
 
 		if (data == START_BYTE) {
 			if (recv_started) {
-				if (i != 0) {
+				if (i == 0)
+					continue;
+
+				/* crc is the last FRAME_CRC_LEN bytes, drop the
+				 * frame if it doesn't check out */
+				if (i > FRAME_CRC_LEN && crc_ccitt(CRC_CCITT_INIT,
+						buf, i) == CRC_CCITT_GOOD) {
 					ungetc(data, in);
-					return i;
+					return i - FRAME_CRC_LEN;
 				}
+				i = 0;
 			} else {
 				recv_started = true;
 			}
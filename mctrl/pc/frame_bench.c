@@ -0,0 +1,139 @@
+/* Throughput of the frame_buf.c encoder and decoder.
+ *
+ * usage: frame_bench [total MiB] [frame bytes]
+ *
+ * Encodes `total` bytes of payload split in frames of `frame bytes`, then
+ * decodes the result (fed in 4 KiB pieces, as read() would hand it over),
+ * with random payload, payload consisting only of bytes needing HDLC
+ * escapes, and all zeros, each with both codecs. Rates are of payload
+ * bytes, overhead is the wire bytes beyond them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "frame_buf.h"
+
+struct check {
+	size_t frames;
+	size_t bytes;
+	const uint8_t *expect;
+	size_t frame_len;
+	size_t bad;
+};
+
+static void check_frame(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct check *c = ctx;
+	if (len != c->frame_len || memcmp(frame,
+			c->expect + c->frames * c->frame_len, len))
+		c->bad++;
+	c->frames++;
+	c->bytes += len;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double mb_s(size_t bytes, double secs)
+{
+	return bytes / secs / 1e6;
+}
+
+static int run(const char *name, const uint8_t *payload, size_t total,
+		size_t frame_len)
+{
+	size_t nframes = total / frame_len;
+	uint8_t *wire = malloc(nframes * FRAME_ENC_MAX(frame_len));
+	uint8_t *frame_buf = malloc(frame_len + FRAME_CRC_LEN);
+	if (!wire || !frame_buf) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	double t0 = now();
+	size_t wire_len = 0;
+	size_t i;
+	for (i = 0; i < nframes; i++)
+		wire_len += frame_encode(wire + wire_len,
+				payload + i * frame_len, frame_len);
+	double t_enc = now() - t0;
+
+	struct frame_dec d;
+	struct check c = { .expect = payload, .frame_len = frame_len };
+	frame_dec_init(&d, frame_buf, frame_len + FRAME_CRC_LEN);
+
+	t0 = now();
+	for (i = 0; i < wire_len; i += 4096) {
+		size_t n = wire_len - i < 4096 ? wire_len - i : 4096;
+		frame_dec_feed(&d, wire + i, n, check_frame, &c);
+	}
+	double t_dec = now() - t0;
+
+	printf("%-13s encode %8.1f MB/s  decode %8.1f MB/s  overhead %5.1f%%\n",
+			name, mb_s(nframes * frame_len, t_enc),
+			mb_s(nframes * frame_len, t_dec),
+			100.0 * (wire_len - nframes * frame_len)
+						/ (nframes * frame_len));
+
+	free(wire);
+	free(frame_buf);
+
+	if (c.frames != nframes || c.bad || d.crc_errors || d.overruns) {
+		fprintf(stderr, "%s: decoded %zu of %zu frames, %zu bad, "
+				"%lu crc errors, %lu overruns\n", name,
+				c.frames, nframes, c.bad, d.crc_errors,
+				d.overruns);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t total = (argc > 1 ? strtoul(argv[1], NULL, 0) : 64) << 20;
+	size_t frame_len = argc > 2 ? strtoul(argv[2], NULL, 0) : 256;
+	if (!frame_len || frame_len > total) {
+		fprintf(stderr, "usage: %s [total MiB] [frame bytes]\n",
+				argv[0]);
+		return 2;
+	}
+
+	uint8_t *payload = malloc(total);
+	if (!payload) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	static const uint8_t special[] = { START_BYTE, ESC_BYTE, RESET_BYTE };
+	static const char *const codecs[] = {
+		[FRAME_CODEC_HDLC] = "hdlc",
+		[FRAME_CODEC_COBS] = "cobs",
+	};
+	int ret = 0, p, k;
+	size_t i;
+	for (p = 0; p < 3; p++) {
+		static const char *const names[] = { "random", "escapes", "zeros" };
+		srand(1);
+		for (i = 0; i < total; i++)
+			payload[i] = p == 0 ? rand()
+				: p == 1 ? special[i % sizeof(special)] : 0;
+
+		for (k = 0; k < 2; k++) {
+			char name[32];
+			snprintf(name, sizeof(name), "%s %s", names[p],
+					codecs[k]);
+			frame_set_codec(k);
+			ret |= run(name, payload, total, frame_len);
+		}
+	}
+
+	free(payload);
+	return ret;
+}
@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "../proto.h"
+#include "crc16.h"
+#include "frame_buf.h"
+
+#define IS_SPECIAL(c) ((c) == START_BYTE || (c) == ESC_BYTE || (c) == RESET_BYTE)
+
+/* the special bytes are 0x7d..0x7f, all of which (and only 0x7c besides)
+ * have 0x7c in the top 6 bits. */
+#define W_ONES ((uint64_t)0x0101010101010101ULL)
+#define W_HAS_ZERO(w) (((w) - W_ONES) & ~(w) & (W_ONES * 0x80))
+
+/* return: offset of the first byte in p[0 .. len) needing to be escaped,
+ *         len if there is none.
+ */
+static size_t scan_special(const uint8_t *p, size_t len)
+{
+	size_t i;
+	for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(w));
+		/* bytes 0x7c .. 0x7f become zero */
+		w = (w & (W_ONES * 0xfc)) ^ (W_ONES * 0x7c);
+		if (W_HAS_ZERO(w)) {
+			size_t j;
+			for (j = 0; j < sizeof(w); j++)
+				if (IS_SPECIAL(p[i + j]))
+					return i + j;
+		}
+	}
+
+	for (; i < len; i++)
+		if (IS_SPECIAL(p[i]))
+			return i;
+	return len;
+}
+
+/* crc16.h works a nibble at a time to keep the table small for the avr,
+ * here a byte at a time is affordable. */
+static uint16_t crc_tbl[256];
+
+static uint16_t crc_buf(uint16_t crc, const uint8_t *d, size_t len)
+{
+	if (!crc_tbl[1]) {
+		unsigned i;
+		for (i = 0; i < 256; i++)
+			crc_tbl[i] = crc_ccitt_update(0, i);
+	}
+
+	while (len--)
+		crc = (crc << 8) ^ crc_tbl[(uint8_t)(crc >> 8) ^ *d++];
+	return crc;
+}
+
+static uint8_t *put_escaped(uint8_t *o, uint8_t c)
+{
+	if (IS_SPECIAL(c)) {
+		*o++ = ESC_BYTE;
+		*o++ = c ^ ESC_MASK;
+	} else {
+		*o++ = c;
+	}
+	return o;
+}
+
+static enum frame_codec codec = FRAME_CODEC_HDLC;
+
+void frame_set_codec(enum frame_codec c)
+{
+	codec = c;
+}
+
+/* frame_set_dest()'s addr, -1 if none */
+static int addr = -1;
+/* the board's credits, if credit_on */
+static struct credit credit;
+static bool credit_on;
+
+void frame_set_dest(uint8_t a)
+{
+	addr = a;
+}
+
+void frame_set_credits(uint8_t slots, uint8_t bytes)
+{
+	credit_init(&credit, slots, bytes);
+	credit_on = true;
+}
+
+bool frame_write_ready(size_t len)
+{
+	return !credit_on || credit_can_send(&credit, len)
+		|| !credit_fits(&credit, len);
+}
+
+/*** Encoding ***/
+struct cobs_enc {
+	uint8_t *o;    /* next byte out */
+	uint8_t *code; /* code byte of the block in progress */
+};
+
+static void cobs_put(struct cobs_enc *e, const uint8_t *p, size_t n)
+{
+	while (n) {
+		size_t room = COBS_BLOCK_MAX - (e->o - e->code - 1);
+		size_t want = n < room ? n : room;
+		const uint8_t *z = memchr(p, 0, want);
+		size_t run = z ? (size_t)(z - p) : want;
+
+		memcpy(e->o, p, run);
+		e->o += run;
+		p += run;
+		n -= run;
+
+		if (z) {
+			/* the zero ends the block */
+			*e->code = e->o - e->code;
+			e->code = e->o++;
+			p++;
+			n--;
+		} else if (run == room) {
+			*e->code = COBS_BLOCK_MAX + 1;
+			e->code = e->o++;
+		}
+	}
+}
+
+static size_t encode_cobs(uint8_t *out, const uint8_t *pre, size_t pre_len,
+		const uint8_t *d, size_t len, uint16_t crc)
+{
+	const uint8_t c[FRAME_CRC_LEN] = { crc >> 8, crc & 0xff };
+	struct cobs_enc e = { .o = out + 2, .code = out + 1 };
+
+	out[0] = COBS_DELIM;
+	cobs_put(&e, pre, pre_len);
+	cobs_put(&e, d, len);
+	cobs_put(&e, c, sizeof(c));
+	*e.code = e.o - e.code;
+	*e.o++ = COBS_DELIM;
+	return e.o - out;
+}
+
+/* frame_encode() of pre[0 .. pre_len) followed by d[0 .. len) */
+static size_t encode(uint8_t *out, const uint8_t *pre, size_t pre_len,
+		const uint8_t *d, size_t len)
+{
+	uint8_t *o = out;
+	const uint8_t *end = d + len;
+	uint16_t crc = crc_buf(crc_buf(CRC_CCITT_INIT, pre, pre_len), d, len);
+	size_t i;
+
+	if (codec == FRAME_CODEC_COBS)
+		return encode_cobs(out, pre, pre_len, d, len, crc);
+
+	*o++ = START_BYTE;
+	for (i = 0; i < pre_len; i++)
+		o = put_escaped(o, pre[i]);
+	while (d < end) {
+		size_t run = scan_special(d, end - d);
+		memcpy(o, d, run);
+		o += run;
+		d += run;
+
+		if (d < end) {
+			*o++ = ESC_BYTE;
+			*o++ = *d++ ^ ESC_MASK;
+		}
+	}
+
+	o = put_escaped(o, crc >> 8);
+	o = put_escaped(o, crc & 0xff);
+	*o++ = START_BYTE;
+
+	return o - out;
+}
+
+size_t frame_encode(void *out, const void *data, size_t len)
+{
+	return encode(out, NULL, 0, data, len);
+}
+
+ssize_t frame_write(int fd, const void *data, size_t len)
+{
+	uint8_t stack_buf[512];
+	uint8_t *buf = stack_buf;
+	uint8_t pre = addr;
+	size_t pre_len = addr >= 0;
+	size_t max = FRAME_ENC_MAX(pre_len + len);
+
+	if (credit_on && !credit_can_send(&credit, len)) {
+		errno = credit_fits(&credit, len) ? EAGAIN : EMSGSIZE;
+		return -1;
+	}
+
+	if (max > sizeof(stack_buf)) {
+		buf = malloc(max);
+		if (!buf)
+			return -1;
+	}
+
+	size_t n = encode(buf, &pre, pre_len, data, len);
+	size_t done = 0;
+	while (done < n) {
+		ssize_t r = write(fd, buf + done, n - done);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		done += r;
+	}
+
+	if (buf != stack_buf) {
+		int e = errno;
+		free(buf);
+		errno = e;
+	}
+
+	/* a frame cut short is dropped by the board, but its rx_frames
+	 * counts it all the same */
+	if (credit_on && done)
+		credit_sent(&credit, len);
+	return done == n ? (ssize_t)len : -1;
+}
+
+/*** Decoding ***/
+void frame_dec_init(struct frame_dec *d, void *buf, size_t cap)
+{
+	memset(d, 0, sizeof(*d));
+	d->buf = buf;
+	d->cap = cap;
+	d->codec = codec;
+	d->addr = addr;
+	d->credits = credit_on;
+}
+
+/* drop the frame in progress, ignore input up to the next flag */
+static void dec_drop(struct frame_dec *d)
+{
+	d->started = false;
+	d->escaped = false;
+	d->cobs_left = 0;
+	d->cobs_zero = false;
+	d->len = 0;
+}
+
+static void dec_put(struct frame_dec *d, const uint8_t *p, size_t n)
+{
+	if (n > d->cap - d->len) {
+		d->overruns++;
+		dec_drop(d);
+		return;
+	}
+
+	memcpy(d->buf + d->len, p, n);
+	d->len += n;
+}
+
+/* closing flag of a non-empty frame.
+ * return: 1 if the frame was handed to fn, 0 if it was dropped */
+static size_t dec_end(struct frame_dec *d, frame_dec_fn fn, void *ctx)
+{
+	if (d->len <= FRAME_CRC_LEN
+			|| crc_buf(CRC_CCITT_INIT, d->buf, d->len)
+							!= CRC_CCITT_GOOD) {
+		d->crc_errors++;
+		return 0;
+	}
+
+	const uint8_t *f = d->buf;
+	size_t len = d->len - FRAME_CRC_LEN;
+
+	if (d->addr >= 0) {
+		if (!(d->addr & FRAME_ADDR_MCAST) && f[0] != d->addr) {
+			d->not_ours++;
+			return 0;
+		}
+		f++;
+		len--;
+	}
+	if (d->credits) {
+		size_t n = credit_recv(&credit, f, len);
+		if (!n) {
+			d->crc_errors++;
+			return 0;
+		}
+		f += n;
+		len -= n;
+	}
+	if (!len)
+		return 0;
+
+	fn(ctx, f, len);
+	return 1;
+}
+
+static size_t dec_feed_cobs(struct frame_dec *d, const uint8_t *in,
+		const uint8_t *end, frame_dec_fn fn, void *ctx)
+{
+	size_t frames = 0;
+
+	while (in < end) {
+		if (!d->started) {
+			/* ignore stuff until we get a delimiter */
+			const uint8_t *f = memchr(in, COBS_DELIM, end - in);
+			if (!f)
+				break;
+			in = f;
+		} else if (d->cobs_left) {
+			size_t want = end - in;
+			if (want > d->cobs_left)
+				want = d->cobs_left;
+			const uint8_t *z = memchr(in, COBS_DELIM, want);
+			size_t run = z ? (size_t)(z - in) : want;
+
+			d->cobs_left -= run;
+			if (!d->cobs_left)
+				d->cobs_zero = d->cobs_code <= COBS_BLOCK_MAX;
+			dec_put(d, in, run);
+			in += run;
+			if (in == end)
+				break;
+		}
+
+		uint8_t c = *in++;
+		if (c == COBS_DELIM) {
+			/* a block cut short leaves the crc to catch it */
+			if (d->started && d->len)
+				frames += dec_end(d, fn, ctx);
+			dec_drop(d);
+			d->started = true;
+		} else if (d->started) {
+			/* code byte of the next block */
+			if (d->cobs_zero) {
+				uint8_t z = 0;
+				d->cobs_zero = false;
+				dec_put(d, &z, 1);
+			}
+			d->cobs_code = c;
+			d->cobs_left = c - 1;
+			d->cobs_zero = !d->cobs_left && c <= COBS_BLOCK_MAX;
+		}
+	}
+
+	return frames;
+}
+
+size_t frame_dec_feed(struct frame_dec *d, const void *vin, size_t len,
+		frame_dec_fn fn, void *ctx)
+{
+	const uint8_t *in = vin;
+	const uint8_t *end = in + len;
+	size_t frames = 0;
+
+	if (d->codec == FRAME_CODEC_COBS)
+		return dec_feed_cobs(d, in, end, fn, ctx);
+
+	while (in < end) {
+		if (!d->started) {
+			/* ignore stuff until we get a start byte */
+			const uint8_t *f = memchr(in, START_BYTE, end - in);
+			if (!f)
+				break;
+			in = f;
+		} else if (!d->escaped) {
+			size_t run = scan_special(in, end - in);
+			dec_put(d, in, run);
+			in += run;
+			if (in == end)
+				break;
+		}
+
+		uint8_t c = *in++;
+		if (c == START_BYTE) {
+			if (d->started && d->len)
+				frames += dec_end(d, fn, ctx);
+			dec_drop(d);
+			d->started = true;
+		} else if (c == RESET_BYTE) {
+			dec_drop(d);
+		} else if (c == ESC_BYTE) {
+			d->escaped = true;
+		} else {
+			/* the escaped form of a special byte, or 0x7c which
+			 * only looked like one to scan_special() */
+			if (d->escaped) {
+				d->escaped = false;
+				c ^= ESC_MASK;
+			}
+			dec_put(d, &c, 1);
+		}
+	}
+
+	return frames;
+}
+
+ssize_t frame_dec_read(struct frame_dec *d, int fd,
+		frame_dec_fn fn, void *ctx)
+{
+	uint8_t buf[4096];
+	ssize_t r;
+
+	do {
+		r = read(fd, buf, sizeof(buf));
+	} while (r < 0 && errno == EINTR);
+
+	if (r > 0)
+		frame_dec_feed(d, buf, r, fn, ctx);
+	return r;
+}
@@ -0,0 +1,125 @@
+#ifndef FRAME_BUF_H_
+#define FRAME_BUF_H_ 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../proto.h"
+#include "credit.h"
+
+/* Buffered host side framing, working on plain memory and fds instead of
+ * stdio one byte at a time. Same wire format as frame_async.c:
+ *  [flag:8] [data:n] [crc:16] [flag:8]
+ * with data and crc either HDLC escaped or COBS encoded (see proto.h),
+ * picked with frame_set_codec().
+ *
+ * Both directions look for the bytes which need escaping (or the zeros, for
+ * COBS) a machine word at a time and move the runs between them with
+ * memcpy, so data without escapes costs little more than the crc.
+ */
+
+enum frame_codec {
+	FRAME_CODEC_HDLC,
+	FRAME_CODEC_COBS, /* the board's FRAME_COBS */
+};
+
+/* The board's FRAME_ADDR and FRAME_CREDITS (../frame_gen.h), for
+ * frame_write() and the decoders set up from then on. Off until set.
+ *
+ * frame_set_dest(addr): addr (an addr8 of proto.h) goes in front of every
+ * frame written, so only that node (or nodes, for a multicast addr) takes
+ * it. Frames decoded start with the addr of the node sending them, which
+ * is stripped. Those from other nodes than addr (unless it is multicast)
+ * are dropped and counted (not_ours).
+ *
+ * frame_set_credits(slots, bytes): frames decoded have the credits at
+ * their front taken (see credit.h) and stripped, and those holding nothing
+ * else are dropped. frame_write() charges each frame against the credits,
+ * starting from slots and bytes (CREDIT_BOARD_*), and fails with EAGAIN
+ * when the board has no room for it yet: read from the board (which sends
+ * the credits as it frees room) and try again. A frame larger than the
+ * board has ever had room for fails with EMSGSIZE.
+ *
+ * frame_encode() is left as it is, with neither.
+ */
+void frame_set_dest(uint8_t addr);
+void frame_set_credits(uint8_t slots, uint8_t bytes);
+
+/* return: false if frame_write() of len bytes would fail with EAGAIN */
+bool frame_write_ready(size_t len);
+
+/* max number of bytes frame_encode() produces for len bytes of data
+ * (every byte escaped, which is also more than COBS ever takes). */
+#define FRAME_ENC_MAX(len) (2 + 2 * ((len) + FRAME_CRC_LEN))
+
+/* codec for frame_encode() and frame_write(), and for decoders set up with
+ * frame_dec_init() from then on. FRAME_CODEC_HDLC until changed. */
+void frame_set_codec(enum frame_codec codec);
+
+/* out: at least FRAME_ENC_MAX(len) bytes.
+ * return: number of bytes written to out, flags included.
+ */
+size_t frame_encode(void *out, const void *data, size_t len);
+
+/* encode and write() the whole frame to fd, which should be blocking,
+ * with the addr and credits of frame_set_dest()/frame_set_credits().
+ * return: len, or -1 with errno set.
+ */
+ssize_t frame_write(int fd, const void *data, size_t len);
+
+/* called by the decoder with each complete frame that passed the crc check
+ * (crc stripped). frame is only valid for the duration of the call. */
+typedef void (*frame_dec_fn)(void *ctx, const uint8_t *frame, size_t len);
+
+/* Decoder state, kept across calls so input may be fed in arbitrary
+ * pieces (as it arrives from a non-blocking fd, or a capture file read in
+ * blocks). */
+struct frame_dec {
+	uint8_t *buf;   /* unescaped data of the frame in progress */
+	size_t cap;
+	size_t len;
+	enum frame_codec codec;
+	bool started;   /* inside a frame (seen its opening flag) */
+	bool escaped;   /* last byte was ESC_BYTE */
+
+	/* COBS: data bytes left in the current block, its code byte, and
+	 * whether the block ended in a zero not yet stored (the last one of
+	 * a frame is not part of it) */
+	uint8_t cobs_left;
+	uint8_t cobs_code;
+	bool cobs_zero;
+
+	/* frames dropped due to a bad crc (or too short to hold one) */
+	unsigned long crc_errors;
+	/* frames dropped for not fitting in buf */
+	unsigned long overruns;
+
+	/* frame_set_dest()'s addr, -1 if none, and frames from others */
+	int addr;
+	unsigned long not_ours;
+	/* frame_set_credits() was called */
+	bool credits;
+};
+
+/* buf: storage for one frame (data + crc), cap bytes long, addr and
+ * credits included.
+ * The decoder uses the codec last passed to frame_set_codec(), and the
+ * addr and credits set by then. */
+void frame_dec_init(struct frame_dec *d, void *buf, size_t cap);
+
+/* decode len bytes of input, calling fn for each good frame.
+ * return: number of frames handed to fn.
+ */
+size_t frame_dec_feed(struct frame_dec *d, const void *in, size_t len,
+		frame_dec_fn fn, void *ctx);
+
+/* read() once from fd and feed whatever arrived to the decoder.
+ * return: as read(): bytes consumed, 0 on end of file, -1 with errno set
+ *         (EAGAIN for a non-blocking fd with nothing to read).
+ */
+ssize_t frame_dec_read(struct frame_dec *d, int fd,
+		frame_dec_fn fn, void *ctx);
+
+#endif
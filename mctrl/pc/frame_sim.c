@@ -0,0 +1,921 @@
+/* Host harness for the firmware framing code.
+ *
+ * usage: frame_sim [-b baud] [-p poll_us] [-l load%] [-n packets]
+ *                  [-c | -f | -r loss% [-w window]]
+ *
+ * ../frame_async.c is built in here unchanged, its (!AVR) ISRs driven from
+ * a simulated usart clocked at `baud` (11 bit characters, as set up by
+ * frame_init). The host end of the link is the frame_buf.c codec. The
+ * firmware side runs the echo loop of main.c every `poll_us`; the host
+ * offers `packets` packets of each of several size distributions at `load`
+ * percent of the line rate and reports:
+ *  - pkt/s: packets echoed back intact per simulated second
+ *  - drop:  packets which did not come back
+ *  - rx_drop: of those, the ones the firmware never got to see
+ *  - hw:    high-water marks of the firmware rx and tx rings, in packets
+ *           and bytes
+ * which is meant to show the effect of buffer sizing (FRAME_DEFINE in
+ * frame_async.c) without flashing a board.
+ *
+ * Built with FRAME_CREDITS (make sim CFLAGS=-DFRAME_CREDITS) the host only
+ * sends as the board's credits allow (credit.h). Built with FRAME_COBS
+ * (and FRAME_TX_PRE_ESCAPE) both ends use COBS.
+ *
+ * With -c the firmware instead keeps its tx ring full of telemetry while
+ * the host sends `packets` short control requests, one at a time, and the
+ * time from the end of each request to the end of its reply is measured:
+ *  - avg_us, max_us: reply latency; max_us is the figure to size against
+ *  - telem: telemetry frames received per second meanwhile
+ * Replies go out with frame_send_urgent when built with FRAME_TX_URGENT
+ * (make sim CFLAGS=-DFRAME_TX_URGENT=16), else with frame_send.
+ *
+ * With -f, `packets` 512 byte messages are sent each way at once, split in
+ * fragments by ../frag.c, and for each direction are reported:
+ *  - msgs, lost: messages reassembled intact, and not
+ *  - bytes/s:    message bytes delivered per second
+ *  - line:       that as a share of the raw line rate
+ *
+ * With -r, `packets` messages go over ../link.c to the firmware, which echoes
+ * them back the same way as main.c does on CHAN_LINK, while `loss` percent
+ * of the frames are lost on the wire each way. The host resets the link
+ * with SABM first, and sends with a window of `window` (4, as the firmware).
+ * Reported are:
+ *  - sent, ok, bad, lost: messages sent, and echoed intact and in order,
+ *    out of order or altered, and not at all; anything but ok is a bug
+ *  - msg/s: messages echoed per second
+ *  - retx, rej, rnr: I frames sent again, REJ and RNR frames sent, by the
+ *    host and by the firmware
+ *  - sabm/ua: SABMs sent by the host, UAs by the firmware
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "frame_buf.h"
+#include "credit.h"
+#include "../frag.h"
+
+/* the wire between the two ends, one character per slot each way */
+static int sim_rx_byte;    /* host => firmware, for the next rx isr */
+static int sim_tx_byte;    /* firmware => host, -1 when the isr sent none */
+
+#define FRAME_SIM_GETC()      (sim_rx_byte)
+#define FRAME_SIM_PUTC(byte)  (sim_tx_byte = (uint8_t)(byte))
+
+#include "../frame_async.c"
+
+#define RX frame_var(usart0, rx)
+#define TX frame_var(usart0, tx)
+
+/* what the board's credits start at. FRAME_JUMBO rings are more than a
+ * credit byte holds, but it runs without credits */
+#define SIM_CREDIT_SLOTS (ARRAY_SIZE(RX.p_idx) - 2)
+#define SIM_CREDIT_BYTES \
+	(sizeof(RX.buf) - 1 > 0xff ? 0xff : sizeof(RX.buf) - 1)
+
+/* bits per character: start, 8 data, parity, stop */
+#define SIM_CHAR_BITS 11
+
+/* largest payload offered, leaves room for the crc in the 32 byte rx ring
+ * of the default channel */
+#define SIM_PAYLOAD_MAX 24
+
+struct dist {
+	const char *name;
+	uint8_t (*len)(void);
+};
+
+static uint8_t len_tiny(void)    { return 1 + rand() % 4; }
+static uint8_t len_uniform(void) { return 1 + rand() % SIM_PAYLOAD_MAX; }
+static uint8_t len_max(void)     { return SIM_PAYLOAD_MAX; }
+static uint8_t len_bimodal(void)
+{
+	return rand() % 10 ? 2 : SIM_PAYLOAD_MAX;
+}
+
+static const struct dist dists[] = {
+	{ "tiny",    len_tiny },
+	{ "uniform", len_uniform },
+	{ "max",     len_max },
+	{ "bimodal", len_bimodal },
+};
+
+struct sim {
+	unsigned long sent;
+	unsigned long echoed;
+	unsigned long fw_got;	/* packets seen by the firmware loop */
+	uint8_t expect[256][SIM_PAYLOAD_MAX + 1];
+	uint8_t expect_len[256];
+	uint8_t next_len;	/* of the packet waiting to be sent, 0 if none */
+	struct credit cr;
+
+	uint8_t rx_pkts_hw;
+	frame_len_t rx_bytes_hw;
+	uint8_t tx_pkts_hw;
+	frame_len_t tx_bytes_hw;
+};
+
+/* echoed frames carry the sequence number the host put in their first
+ * byte, check them against what was sent. */
+static void host_recv(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct sim *s = ctx;
+	if (F_ADDR_EN) {
+		frame++;
+		len--;
+	}
+	if (F_CREDIT_LEN) {
+		size_t n = credit_recv(&s->cr, frame, len);
+		frame += n;
+		len -= n;
+		if (!len)
+			return;
+	}
+
+	uint8_t seq = frame[0];
+	if (len == s->expect_len[seq] && !memcmp(frame, s->expect[seq], len))
+		s->echoed++;
+	s->expect_len[seq] = 0;
+}
+
+/* main.c's loop, with echo_packet(). With credits the packet is held
+ * until its echo is queued, so the host is held up by the credits instead
+ * of the echo being lost; unless it doesn't fit even the empty tx ring. */
+static void fw_poll(struct sim *sim)
+{
+	struct frame_seg seg[2];
+	if (frame_recv_peek(seg)) {
+		if (F_CREDIT_LEN) {
+			if (!frame_sendv(seg, 2)
+					&& !frame_fn(usart0, tx_idle)())
+				return;
+		} else {
+			frame_len_t i;
+			uint8_t s;
+			frame_start();
+			for (s = 0; s < 2; s++)
+				for (i = 0; i < seg[s].len; i++)
+					frame_append_u8(seg[s].data[i]);
+			frame_done();
+		}
+		sim->fw_got++;
+		frame_recv_commit();
+	}
+}
+
+/*** control latency (-c) ***/
+#define CTL_TAG   'C'
+#define TELEM_TAG 'T'
+
+#if defined(FRAME_TX_URGENT)
+# define fw_send_ctl frame_send_urgent
+#else
+# define fw_send_ctl frame_send
+#endif
+
+struct ctl {
+	unsigned long sent, got, lost, telem;
+	double sum_us, max_us;
+	bool waiting;		/* for the reply to request `seq` */
+	uint8_t seq;
+	unsigned long sent_slot; /* the request's last byte went out */
+	unsigned long slot;	/* now */
+	double slot_us;
+	struct credit cr;
+};
+
+static void ctl_host_recv(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct ctl *c = ctx;
+	if (F_ADDR_EN) {
+		frame++;
+		len--;
+	}
+	if (F_CREDIT_LEN) {
+		size_t n = credit_recv(&c->cr, frame, len);
+		frame += n;
+		len -= n;
+	}
+	if (!len)
+		return;
+
+	if (frame[0] == TELEM_TAG) {
+		c->telem++;
+	} else if (frame[0] == CTL_TAG && len == 2 && c->waiting
+			&& frame[1] == c->seq) {
+		double us = (c->slot - c->sent_slot) * c->slot_us;
+		c->sum_us += us;
+		if (us > c->max_us)
+			c->max_us = us;
+		c->got++;
+		c->waiting = false;
+	}
+}
+
+/* answer control requests, and fill whatever room is left in tx with
+ * telemetry */
+static void fw_ctl_poll(void)
+{
+	static int pending = -1;
+	static const uint8_t telem[SIM_PAYLOAD_MAX] = { TELEM_TAG };
+	uint8_t req[4];
+
+	if (pending < 0) {
+		uint8_t len = frame_recv_copy(req, sizeof(req));
+		if (len) {
+			if (len == 2 && req[0] == CTL_TAG)
+				pending = req[1];
+			frame_recv_next();
+		}
+	}
+
+	if (pending >= 0) {
+		const uint8_t rep[2] = { CTL_TAG, pending };
+		if (fw_send_ctl(rep, sizeof(rep)))
+			pending = -1;
+	}
+
+	while (frame_send(telem, sizeof(telem)))
+		;
+}
+
+static void run_ctl(unsigned long requests, unsigned long baud,
+		unsigned long poll_us)
+{
+	static struct ctl c;
+	memset(&c, 0, sizeof(c));
+	memset(&RX, 0, sizeof(RX));
+	memset(&TX, 0, sizeof(TX));
+	frame_var(usart0, rx_frames) = 0;
+	frame_init();
+	credit_init(&c.cr, SIM_CREDIT_SLOTS, SIM_CREDIT_BYTES);
+	c.slot_us = SIM_CHAR_BITS * 1e6 / baud;
+
+	uint8_t dec_buf[SIM_PAYLOAD_MAX + FRAME_CRC_LEN + F_ADDR_EN
+							+ F_CREDIT_LEN];
+	struct frame_dec dec;
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	uint8_t wire[FRAME_ENC_MAX(2 + F_ADDR_EN)];
+	size_t wire_len = 0, wire_pos = 0;
+	/* a random gap before each request keeps it from always landing at
+	 * the same point of a telemetry frame */
+	unsigned long idle = 0;
+	/* give up on a reply after 1s */
+	unsigned long timeout = 1e6 / c.slot_us;
+	double poll_at = 0;
+
+	for (c.slot = 0; c.got + c.lost < requests; c.slot++) {
+		if (c.waiting && wire_pos == wire_len
+				&& c.slot - c.sent_slot > timeout) {
+			c.lost++;
+			c.waiting = false;
+		}
+
+		/* host => firmware */
+		if (!c.waiting && wire_pos == wire_len && !idle
+				&& c.sent < requests && (!F_CREDIT_LEN
+				|| credit_can_send(&c.cr, 2))) {
+			uint8_t pkt[1 + 2];
+			if (F_ADDR_EN)
+				pkt[0] = FRAME_ADDR8(0, 0);
+			pkt[F_ADDR_EN] = CTL_TAG;
+			pkt[F_ADDR_EN + 1] = ++c.seq;
+			wire_len = frame_encode(wire, pkt, F_ADDR_EN + 2);
+			wire_pos = 0;
+			if (F_CREDIT_LEN)
+				credit_sent(&c.cr, 2);
+			c.sent++;
+			c.waiting = true;
+			idle = rand() % 64;
+		}
+
+		if (wire_pos < wire_len) {
+			sim_rx_byte = wire[wire_pos++];
+			frame_rx_isr();
+			if (wire_pos == wire_len)
+				c.sent_slot = c.slot;
+		} else if (!c.waiting && idle) {
+			idle--;
+		}
+
+		/* firmware => host */
+		sim_tx_byte = -1;
+		frame_tx_isr();
+		if (sim_tx_byte >= 0) {
+			uint8_t b = sim_tx_byte;
+			frame_dec_feed(&dec, &b, 1, ctl_host_recv, &c);
+		}
+
+		if (c.slot * c.slot_us >= poll_at) {
+			fw_ctl_poll();
+			poll_at += poll_us;
+		}
+	}
+
+	double secs = c.slot * c.slot_us / 1e6;
+	printf("%9lu %7lu %9.0f %9.0f %11.1f\n", c.got, c.lost,
+			c.got ? c.sum_us / c.got : 0, c.max_us,
+			c.telem / secs);
+}
+
+/*** bulk transfer (-f) ***/
+#define BULK_LEN 512
+
+/* message bytes, a function of the message number and offset */
+static uint8_t bulk_byte(uint8_t msg, uint16_t i)
+{
+	return msg * 31 + i * 7 + (i >> 8);
+}
+
+static void bulk_fill(uint8_t *buf, uint8_t msg, uint16_t len)
+{
+	uint16_t i;
+	for (i = 0; i < len; i++)
+		buf[i] = bulk_byte(msg, i);
+}
+
+static bool bulk_check(const uint8_t *buf, uint8_t msg, uint16_t len)
+{
+	uint16_t i;
+	if (len != BULK_LEN)
+		return false;
+	for (i = 0; i < len; i++)
+		if (buf[i] != bulk_byte(msg, i))
+			return false;
+	return true;
+}
+
+/* one direction of the transfer */
+struct bulk {
+	struct frag_tx tx;
+	struct frag_rx rx;
+	uint8_t tx_buf[BULK_LEN];
+	uint8_t rx_buf[BULK_LEN];
+	unsigned long sent; /* messages handed to frag_send */
+	unsigned long ok;   /* messages reassembled intact at the far end */
+	unsigned long done_slot;
+};
+
+static struct bulk up, down; /* host => firmware, firmware => host */
+
+/* the host's wire, one frame at a time */
+static uint8_t bulk_wire[FRAME_ENC_MAX(F_ADDR_EN + FRAG_HDR_LEN
+							+ FRAG_DATA_MAX)];
+static size_t bulk_wire_len, bulk_wire_pos;
+static struct credit bulk_cr;
+
+static bool bulk_host_xmit(const void *frame, uint8_t len)
+{
+	uint8_t pkt[1 + FRAG_HDR_LEN + FRAG_DATA_MAX];
+	if (bulk_wire_pos < bulk_wire_len
+			|| (F_CREDIT_LEN && !credit_can_send(&bulk_cr, len)))
+		return false;
+	if (F_ADDR_EN)
+		pkt[0] = FRAME_ADDR8(0, 0);
+	memcpy(pkt + F_ADDR_EN, frame, len);
+	bulk_wire_len = frame_encode(bulk_wire, pkt, F_ADDR_EN + len);
+	bulk_wire_pos = 0;
+	if (F_CREDIT_LEN)
+		credit_sent(&bulk_cr, len);
+	return true;
+}
+
+/* frame_send() for frag, whose lengths are 8 bit */
+static bool bulk_fw_xmit(const void *frame, uint8_t len)
+{
+	return frame_send(frame, len);
+}
+
+static void bulk_host_recv(void *ctx, const uint8_t *frame, size_t len)
+{
+	if (F_ADDR_EN) {
+		frame++;
+		len--;
+	}
+	if (F_CREDIT_LEN) {
+		size_t n = credit_recv(&bulk_cr, frame, len);
+		frame += n;
+		len -= n;
+	}
+	if (!len || !FRAG_IS(frame[0]))
+		return;
+
+	uint16_t n = frag_recv(&down.rx, frame, len);
+	if (n && bulk_check(down.rx_buf, down.rx.msg, n))
+		down.ok++;
+}
+
+/* main.c's handling of fragments, but checking what arrives and sending a
+ * stream of its own instead of echoing it */
+static void fw_bulk_poll(unsigned long messages)
+{
+	uint8_t f[FRAG_HDR_LEN + FRAG_DATA_MAX];
+	uint8_t len = frame_recv_copy(f, sizeof(f));
+	if (len) {
+		if (len <= sizeof(f) && FRAG_IS(f[0])) {
+			uint16_t n = frag_recv(&up.rx, f, len);
+			if (n && bulk_check(up.rx_buf, up.rx.msg, n))
+				up.ok++;
+		}
+		frame_recv_next();
+	}
+
+	if (!frag_tx_poll(&down.tx))
+		return;
+	if (down.sent < messages) {
+		bulk_fill(down.tx_buf, down.tx.msg, BULK_LEN);
+		frag_send(&down.tx, down.tx_buf, BULK_LEN);
+		down.sent++;
+	}
+}
+
+static void bulk_report(const char *dir, const struct bulk *b, double slot_us,
+		unsigned long baud)
+{
+	double secs = b->done_slot * slot_us / 1e6;
+	double rate = b->ok * BULK_LEN / secs;
+	printf("%-8s %9lu %7lu %9.0f %6.1f%%\n", dir, b->ok, b->sent - b->ok,
+			rate, 100 * rate * SIM_CHAR_BITS / baud);
+}
+
+static void run_bulk(unsigned long messages, unsigned long baud,
+		unsigned long poll_us)
+{
+	memset(&up, 0, sizeof(up));
+	memset(&down, 0, sizeof(down));
+	memset(&RX, 0, sizeof(RX));
+	memset(&TX, 0, sizeof(TX));
+	frame_var(usart0, rx_frames) = 0;
+	frame_init();
+	credit_init(&bulk_cr, SIM_CREDIT_SLOTS, SIM_CREDIT_BYTES);
+	bulk_wire_len = bulk_wire_pos = 0;
+
+	double slot_us = SIM_CHAR_BITS * 1e6 / baud;
+	/* stalled messages are dropped after 100ms */
+	uint16_t timeout = 100000 / slot_us + 1;
+	frag_tx_init(&up.tx, bulk_host_xmit, FRAG_DATA_MAX);
+	frag_tx_init(&down.tx, bulk_fw_xmit, FRAG_DATA_MAX);
+	frag_rx_init(&up.rx, up.rx_buf, sizeof(up.rx_buf), timeout);
+	frag_rx_init(&down.rx, down.rx_buf, sizeof(down.rx_buf), timeout);
+
+	uint8_t dec_buf[F_ADDR_EN + F_CREDIT_LEN + FRAG_HDR_LEN
+					+ FRAG_DATA_MAX + FRAME_CRC_LEN];
+	struct frame_dec dec;
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	double poll_at = 0;
+	unsigned long slot, quiet = 0;
+
+	for (slot = 0; ; slot++) {
+		/* host => firmware */
+		if (frag_tx_poll(&up.tx) && up.sent < messages) {
+			bulk_fill(up.tx_buf, up.tx.msg, BULK_LEN);
+			frag_send(&up.tx, up.tx_buf, BULK_LEN);
+			up.sent++;
+		}
+
+		if (bulk_wire_pos < bulk_wire_len) {
+			sim_rx_byte = bulk_wire[bulk_wire_pos++];
+			frame_rx_isr();
+		}
+
+		/* firmware => host */
+		sim_tx_byte = -1;
+		frame_tx_isr();
+		if (sim_tx_byte >= 0) {
+			uint8_t b = sim_tx_byte;
+			frame_dec_feed(&dec, &b, 1, bulk_host_recv, NULL);
+		}
+
+		if (slot * slot_us >= poll_at) {
+			fw_bulk_poll(messages);
+			poll_at += poll_us;
+		}
+		frag_rx_poll(&up.rx, slot);
+		frag_rx_poll(&down.rx, slot);
+
+		if (!up.done_slot && up.sent == messages
+				&& !frag_tx_busy(&up.tx)
+				&& bulk_wire_pos == bulk_wire_len
+				&& !frame_recv_have_pkt())
+			up.done_slot = slot;
+		if (!down.done_slot && down.sent == messages
+				&& !frag_tx_busy(&down.tx) && sim_tx_byte < 0
+				&& frame_tx_drained())
+			down.done_slot = slot;
+
+		if (up.done_slot && down.done_slot) {
+			if (++quiet > 16)
+				break;
+		}
+	}
+
+	bulk_report("up", &up, slot_us, baud);
+	bulk_report("down", &down, slot_us, baud);
+}
+
+/*** reliable link (-r) ***/
+/* retransmit timeout of both ends, ms, and the firmware's window (main.c's
+ * link, and the host's unless -w) */
+#define LINK_SIM_T1_MS 200
+#define LINK_SIM_WINDOW 4
+
+struct link_end {
+	struct link l;
+	unsigned long i_frames, rej, rnr, sabm, ua;
+};
+
+static struct {
+	struct link_end host, fw;
+	unsigned long sent, ok, bad;
+	unsigned long echoed;	/* messages queued by the firmware */
+	uint16_t next;		/* message number expected back */
+	bool up;		/* the host has had its UA */
+	unsigned loss;		/* per 1000 frames, either way */
+	uint8_t wire[FRAME_ENC_MAX(F_ADDR_EN + 1 + LINK_INFO_MAX)];
+	size_t wire_len, wire_pos;
+	struct credit cr;
+} lk;
+
+static bool link_sim_lost(void)
+{
+	return (unsigned)(rand() % 1000) < lk.loss;
+}
+
+static void link_sim_count(struct link_end *e, uint8_t ctrl)
+{
+	if (LINK_IS_I(ctrl))
+		e->i_frames++;
+	else if (LINK_IS_S(ctrl) && LINK_S_TYPE(ctrl) == LINK_S_REJ)
+		e->rej++;
+	else if (LINK_IS_S(ctrl) && LINK_S_TYPE(ctrl) == LINK_S_RNR)
+		e->rnr++;
+	else if ((ctrl & ~LINK_PF) == LINK_U_SABM)
+		e->sabm++;
+	else if ((ctrl & ~LINK_PF) == LINK_U_UA)
+		e->ua++;
+}
+
+/* the host's wire, one frame at a time, some of them lost */
+static bool link_host_xmit(const void *frame, uint8_t len)
+{
+	uint8_t pkt[F_ADDR_EN + 1 + LINK_INFO_MAX];
+	if (lk.wire_pos < lk.wire_len
+			|| (F_CREDIT_LEN && !credit_can_send(&lk.cr, len)))
+		return false;
+	link_sim_count(&lk.host, *(const uint8_t *)frame);
+	if (link_sim_lost())
+		return true;
+	if (F_ADDR_EN)
+		pkt[0] = FRAME_ADDR8(0, 0);
+	memcpy(pkt + F_ADDR_EN, frame, len);
+	lk.wire_len = frame_encode(lk.wire, pkt, F_ADDR_EN + len);
+	lk.wire_pos = 0;
+	if (F_CREDIT_LEN)
+		credit_sent(&lk.cr, len);
+	return true;
+}
+
+static bool link_fw_xmit(const void *frame, uint8_t len)
+{
+	if (!frame_send(frame, len))
+		return false;
+	link_sim_count(&lk.fw, *(const uint8_t *)frame);
+	return true;
+}
+
+/* message n: [n:16] and a pattern, 2 .. LINK_INFO_MAX bytes */
+static uint8_t link_msg(uint8_t *m, uint16_t n)
+{
+	uint8_t len = 2 + n % (LINK_INFO_MAX - 1), i;
+	m[0] = n >> 8;
+	m[1] = n;
+	for (i = 2; i < len; i++)
+		m[i] = n * 13 + i;
+	return len;
+}
+
+static void link_host_recv(void *ctx, const uint8_t *frame, size_t len)
+{
+	(void)ctx;
+	if (F_ADDR_EN) {
+		frame++;
+		len--;
+	}
+	if (F_CREDIT_LEN) {
+		size_t n = credit_recv(&lk.cr, frame, len);
+		frame += n;
+		len -= n;
+	}
+	if (!len || link_sim_lost())
+		return;
+
+	if ((frame[0] & ~LINK_PF) == LINK_U_UA)
+		lk.up = true;
+	if (!link_recv(&lk.host.l, frame[0]))
+		return;
+
+	uint8_t m[LINK_INFO_MAX];
+	if (len - 1 == link_msg(m, lk.next) && !memcmp(frame + 1, m, len - 1))
+		lk.ok++;
+	else
+		lk.bad++;
+	lk.next++;
+}
+
+/* main.c's link_packet(): echo what arrives, refusing it while the window
+ * for the echoes is full, or if it is too long to ever be echoed */
+static void fw_link_poll(uint16_t now)
+{
+	uint8_t f[1 + LINK_INFO_MAX];
+	frame_len_t len = frame_recv_copy(f, sizeof(f));
+
+	if (len) {
+		if (link_recv(&lk.fw.l, f[0])) {
+			if (len <= sizeof(f)
+					&& link_send(&lk.fw.l, f + 1, len - 1))
+				lk.echoed++;
+			else
+				link_refuse(&lk.fw.l);
+		}
+		frame_recv_next();
+	}
+	if (link_can_send(&lk.fw.l))
+		link_set_busy(&lk.fw.l, false);
+	link_poll(&lk.fw.l, now);
+}
+
+static void run_link(unsigned long messages, unsigned long baud,
+		unsigned long poll_us, unsigned loss, uint8_t window)
+{
+	memset(&lk, 0, sizeof(lk));
+	lk.loss = loss;
+	memset(&RX, 0, sizeof(RX));
+	memset(&TX, 0, sizeof(TX));
+	frame_var(usart0, rx_frames) = 0;
+	frame_init();
+	credit_init(&lk.cr, SIM_CREDIT_SLOTS, SIM_CREDIT_BYTES);
+	link_init(&lk.host.l, link_host_xmit, window, LINK_SIM_T1_MS);
+	link_init(&lk.fw.l, link_fw_xmit, LINK_SIM_WINDOW, LINK_SIM_T1_MS);
+
+	uint8_t dec_buf[F_ADDR_EN + F_CREDIT_LEN + 1 + LINK_INFO_MAX
+							+ FRAME_CRC_LEN];
+	struct frame_dec dec;
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	double slot_us = SIM_CHAR_BITS * 1e6 / baud;
+	double poll_at = 0;
+	/* give up once nothing has come back for 10s */
+	unsigned long slot, last_slot = 0, stall = 10e6 / slot_us;
+	unsigned long done = 0;
+	uint16_t sabm_at = 0;
+
+	for (slot = 0; lk.ok + lk.bad < messages
+			&& slot - last_slot < stall; slot++) {
+		uint16_t now = slot * slot_us / 1000;
+
+		/* host => firmware: SABM until the UA, then the messages */
+		if (!lk.up) {
+			if (!slot || (uint16_t)(now - sabm_at) >= LINK_SIM_T1_MS) {
+				link_reset(&lk.host.l);
+				sabm_at = now;
+			}
+		} else {
+			uint8_t m[LINK_INFO_MAX];
+			if (lk.sent < messages && link_can_send(&lk.host.l)
+					&& link_send(&lk.host.l, m,
+						link_msg(m, lk.sent)))
+				lk.sent++;
+			link_poll(&lk.host.l, now);
+		}
+
+		if (lk.wire_pos < lk.wire_len) {
+			sim_rx_byte = lk.wire[lk.wire_pos++];
+			frame_rx_isr();
+		}
+
+		/* firmware => host */
+		sim_tx_byte = -1;
+		frame_tx_isr();
+		if (sim_tx_byte >= 0) {
+			uint8_t b = sim_tx_byte;
+			frame_dec_feed(&dec, &b, 1, link_host_recv, NULL);
+		}
+
+		if (slot * slot_us >= poll_at) {
+			fw_link_poll(now);
+			poll_at += poll_us;
+		}
+
+		if (lk.ok + lk.bad != done) {
+			done = lk.ok + lk.bad;
+			last_slot = slot;
+		}
+	}
+
+	double secs = slot * slot_us / 1e6;
+	printf("%4.1f%% %7lu %7lu %5lu %7lu %7.1f %5lu/%-5lu %4lu/%-4lu "
+			"%3lu/%-3lu %3lu/%-3lu\n",
+			lk.loss / 10.0, lk.sent, lk.ok, lk.bad,
+			messages - lk.ok - lk.bad, lk.ok / secs,
+			lk.host.i_frames - lk.sent,
+			lk.fw.i_frames - lk.echoed,
+			lk.host.rej, lk.fw.rej, lk.host.rnr, lk.fw.rnr,
+			lk.host.sabm, lk.fw.ua);
+}
+
+#define HW(hw, x) do { unsigned _x = (x); if (_x > (hw)) (hw) = _x; } while (0)
+
+static void ring_hw(struct sim *s)
+{
+	uint8_t rx_next = CIRC_NEXT(RX.head, ARRAY_SIZE(RX.p_idx));
+	HW(s->rx_pkts_hw, CIRC_CNT(RX.head, RX.tail, ARRAY_SIZE(RX.p_idx)));
+	HW(s->rx_bytes_hw, CIRC_CNT(RX.p_idx[rx_next], RX.p_idx[RX.tail],
+				sizeof(RX.buf)));
+	HW(s->tx_pkts_hw, CIRC_CNT(TX.head, TX.tail, ARRAY_SIZE(TX.p_idx)));
+	HW(s->tx_bytes_hw, CIRC_CNT(TX.p_idx[TX.head], TX.p_idx[TX.tail],
+				sizeof(TX.buf)));
+}
+
+static void run(const struct dist *dist, unsigned long packets,
+		unsigned long baud, unsigned long poll_us, unsigned load)
+{
+	static struct sim s;
+	memset(&s, 0, sizeof(s));
+	memset(&RX, 0, sizeof(RX));
+	memset(&TX, 0, sizeof(TX));
+	frame_var(usart0, rx_frames) = 0;
+	frame_init();
+	credit_init(&s.cr, SIM_CREDIT_SLOTS, SIM_CREDIT_BYTES);
+	uint8_t crc_errors = frame_recv_crc_errors();
+
+	uint8_t dec_buf[SIM_PAYLOAD_MAX + 1 + FRAME_CRC_LEN + F_ADDR_EN
+							+ F_CREDIT_LEN];
+	struct frame_dec dec;
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	uint8_t wire[FRAME_ENC_MAX(SIM_PAYLOAD_MAX + 1 + F_ADDR_EN)];
+	size_t wire_len = 0, wire_pos = 0;
+	unsigned long idle = 0;
+
+	double slot_us = SIM_CHAR_BITS * 1e6 / baud;
+	double poll_at = 0;
+	unsigned long slot, quiet = 0;
+
+	for (slot = 0; ; slot++) {
+		/* host => firmware */
+		if (wire_pos == wire_len && !idle && s.sent < packets
+				&& !s.next_len)
+			s.next_len = dist->len();
+
+		if (s.next_len && (!F_CREDIT_LEN
+				|| credit_can_send(&s.cr, s.next_len))) {
+			uint8_t pkt[1 + SIM_PAYLOAD_MAX + 1];
+			uint8_t len = s.next_len, i;
+			uint8_t seq = s.sent;
+			if (F_ADDR_EN)
+				pkt[0] = FRAME_ADDR8(0, 0);
+			pkt[F_ADDR_EN] = seq;
+			for (i = 1; i < len; i++)
+				pkt[F_ADDR_EN + i] = rand();
+			memcpy(s.expect[seq], pkt + F_ADDR_EN, len);
+			s.expect_len[seq] = len;
+
+			wire_len = frame_encode(wire, pkt, F_ADDR_EN + len);
+			if (F_CREDIT_LEN)
+				credit_sent(&s.cr, len);
+			s.next_len = 0;
+			wire_pos = 0;
+			idle = load < 100 ? wire_len * (100 - load) / load : 0;
+			s.sent++;
+		}
+
+		if (wire_pos < wire_len) {
+			sim_rx_byte = wire[wire_pos++];
+			frame_rx_isr();
+		} else if (idle) {
+			idle--;
+		}
+
+		/* firmware => host */
+		sim_tx_byte = -1;
+		frame_tx_isr();
+		if (sim_tx_byte >= 0) {
+			uint8_t b = sim_tx_byte;
+			frame_dec_feed(&dec, &b, 1, host_recv, &s);
+		}
+
+		ring_hw(&s);
+
+		if (slot * slot_us >= poll_at) {
+			fw_poll(&s);
+			poll_at += poll_us;
+		}
+
+		/* done once everything is sent and the link has gone quiet */
+		if (s.sent == packets && wire_pos == wire_len
+				&& sim_tx_byte < 0 && !frame_recv_have_pkt()) {
+			if (++quiet > 16)
+				break;
+		} else {
+			quiet = 0;
+		}
+	}
+
+	double secs = slot * slot_us / 1e6;
+	unsigned long lost = s.sent - s.echoed;
+	printf("%-8s %9.1f %6.2f%% %6.2f%% %7u %5u/%-4u %5u/%-4u\n",
+			dist->name, s.echoed / secs,
+			100.0 * lost / s.sent,
+			100.0 * (s.sent - s.fw_got) / s.sent,
+			(uint8_t)(frame_recv_crc_errors() - crc_errors),
+			s.rx_pkts_hw, s.rx_bytes_hw,
+			s.tx_pkts_hw, s.tx_bytes_hw);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long baud = 38400;
+	unsigned long poll_us = 100;
+	unsigned long packets = 10000;
+	unsigned load = 100;
+	bool ctl = false, bulk = false;
+	double loss = -1;
+	unsigned window = LINK_SIM_WINDOW;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:p:l:n:cfr:w:")) != -1) {
+		switch (opt) {
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 'p': poll_us = strtoul(optarg, NULL, 0); break;
+		case 'l': load = strtoul(optarg, NULL, 0); break;
+		case 'n': packets = strtoul(optarg, NULL, 0); break;
+		case 'c': ctl = true; break;
+		case 'f': bulk = true; break;
+		case 'r': loss = strtod(optarg, NULL); break;
+		case 'w': window = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-b baud] [-p poll_us] "
+					"[-l load%%] [-n packets] "
+					"[-c | -f | -r loss%% [-w window]]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	if (!baud || !poll_us || !packets || !load || load > 100
+			|| loss > 100 || !window || window > LINK_WINDOW_MAX) {
+		fprintf(stderr, "%s: bad argument\n", argv[0]);
+		return 2;
+	}
+
+	srand(1);
+	if (F_COBS_EN)
+		frame_set_codec(FRAME_CODEC_COBS);
+	if (ctl) {
+		printf("baud %lu, poll %lu us, %lu requests, reply by %s\n",
+				baud, poll_us, packets,
+				F_TX_URGENT_EN ? "frame_send_urgent" : "frame_send");
+		printf("%9s %7s %9s %9s %11s\n", "replies", "lost",
+				"avg_us", "max_us", "telem pkt/s");
+		run_ctl(packets, baud, poll_us);
+		return 0;
+	}
+
+	if (loss >= 0) {
+		printf("baud %lu, poll %lu us, %lu messages, windows %u/%u, "
+				"t1 %u ms\n", baud, poll_us, packets,
+				window, LINK_SIM_WINDOW,
+				LINK_SIM_T1_MS);
+		printf("%5s %7s %7s %5s %7s %7s %11s %9s %7s %7s\n", "loss",
+				"sent", "ok", "bad", "lost", "msg/s",
+				"retx h/fw", "rej h/fw", "rnr h/fw",
+				"sabm/ua");
+		run_link(packets, baud, poll_us, loss * 10 + 0.5, window);
+		return 0;
+	}
+
+	if (bulk) {
+		printf("baud %lu, poll %lu us, %lu messages of %u bytes each way\n",
+				baud, poll_us, packets, BULK_LEN);
+		printf("%-8s %9s %7s %9s %7s\n", "dir", "msgs", "lost",
+				"bytes/s", "line");
+		run_bulk(packets, baud, poll_us);
+		return 0;
+	}
+
+	printf("baud %lu, poll %lu us, load %u%%, %lu packets\n",
+			baud, poll_us, load, packets);
+	printf("%-8s %9s %7s %7s %7s %10s %10s\n", "dist", "pkt/s", "drop",
+			"rx_drop", "crc_err", "rx_hw p/b", "tx_hw p/b");
+
+	size_t i;
+	for (i = 0; i < ARRAY_SIZE(dists); i++)
+		run(&dists[i], packets, baud, poll_us, load);
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+/* Send stdin over the board's reliable link and print what comes back.
+ *
+ * usage: linkcat [-C] [-a node] [-k] [-w window] [-t t1_ms] tty
+ *
+ * Resets the link on CHAN_LINK (SABM, see ../link.h), then sends stdin in
+ * I frames of up to LINK_INFO_MAX bytes, keeping up to `window` (4 by
+ * default, the board's) unacked. The board echoes the data back over the
+ * link, which goes to stdout. Lost or damaged frames are sent again, by
+ * either end, so stdout gets all of stdin in order or linkcat fails. It
+ * exits once all of stdin is acked and echoed. A window larger than the
+ * board's works, but has the board refuse frames it can't echo yet. t1_ms
+ * (250 by default) is the retransmit timeout, which needs to be longer than
+ * the round trip of a full window. -C talks COBS, for a board built with
+ * FRAME_COBS, -a to `node` of a board built with FRAME_ADDR and -k keeps to
+ * the credits of one built with FRAME_CREDITS (a frame the board has no
+ * room for yet goes as the link's next poll).
+ *
+ * On exit, the frames sent and sent again, and REJ and RNR received, go to
+ * stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../proto.h"
+#include "../link.h"
+#include "frame_buf.h"
+#include "serial.h"
+
+/* largest frame taken from the board */
+#define FRAME_MAX 1024
+/* give up after this long without the link moving */
+#define STALL_MS 10000
+
+static struct {
+	int tty;
+	struct link l;
+	bool up;           /* UA seen */
+	unsigned long sent, got;
+
+	unsigned long frames, i_frames, rej, rnr;
+} lc;
+
+static uint32_t ms_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool lc_xmit(const void *frame, uint8_t len)
+{
+	uint8_t pkt[1 + 1 + LINK_INFO_MAX];
+
+	pkt[0] = CHAN_LINK;
+	memcpy(pkt + 1, frame, len);
+	if (frame_write(lc.tty, pkt, 1 + len) < 0)
+		return false;
+	if (LINK_IS_I(pkt[1]))
+		lc.i_frames++;
+	return true;
+}
+
+static void tty_frame(void *ctx, const uint8_t *frame, size_t len)
+{
+	(void)ctx;
+
+	if (len < 2 || frame[0] != CHAN_LINK)
+		return;
+
+	uint8_t ctrl = frame[1];
+	if ((ctrl & ~LINK_PF) == LINK_U_UA)
+		lc.up = true;
+	else if (LINK_IS_S(ctrl) && LINK_S_TYPE(ctrl) == LINK_S_REJ)
+		lc.rej++;
+	else if (LINK_IS_S(ctrl) && LINK_S_TYPE(ctrl) == LINK_S_RNR)
+		lc.rnr++;
+
+	if (!link_recv(&lc.l, ctrl))
+		return;
+
+	if (fwrite(frame + 2, 1, len - 2, stdout) != len - 2) {
+		perror("stdout");
+		exit(1);
+	}
+	fflush(stdout);
+	lc.got += len - 2;
+}
+
+/* return: 0 once all of stdin is through, -1 with errno set otherwise */
+static int lc_run(uint16_t t1)
+{
+	uint8_t dec_buf[FRAME_MAX + FRAME_CRC_LEN];
+	struct frame_dec dec;
+	uint32_t moved = ms_now(), sabm = moved - t1;
+	unsigned long last_got = 0;
+	uint8_t last_va = 0;
+	bool eof = false;
+
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	for (;;) {
+		uint32_t now = ms_now();
+
+		if (!lc.up && now - sabm >= t1) {
+			link_reset(&lc.l);
+			sabm = now;
+		}
+		if (lc.up)
+			link_poll(&lc.l, now);
+
+		if (eof && lc.l.va == lc.l.vs && lc.got >= lc.sent)
+			return 0;
+
+		/* idle on stdin is no stall */
+		bool waiting = !lc.up || lc.l.va != lc.l.vs
+				|| lc.got < lc.sent;
+		if (!waiting || lc.l.va != last_va || lc.got != last_got) {
+			last_va = lc.l.va;
+			last_got = lc.got;
+			moved = now;
+		} else if (now - moved >= STALL_MS) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		struct pollfd p[2] = {
+			{ .fd = lc.tty, .events = POLLIN },
+			{ .fd = STDIN_FILENO, .events = POLLIN },
+		};
+		bool want = lc.up && !eof && link_can_send(&lc.l);
+		if (poll(p, want ? 2 : 1, t1 / 4 + 1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (p[0].revents) {
+			ssize_t r = frame_dec_read(&dec, lc.tty, tty_frame,
+					NULL);
+			if (!r) {
+				errno = EIO;
+				return -1;
+			}
+			if (r < 0 && errno != EAGAIN && errno != EINTR)
+				return -1;
+		}
+
+		if (want && p[1].revents) {
+			uint8_t buf[LINK_INFO_MAX];
+			ssize_t r = read(STDIN_FILENO, buf, sizeof(buf));
+			if (r < 0 && errno != EAGAIN && errno != EINTR)
+				return -1;
+			if (!r)
+				eof = true;
+			if (r > 0) {
+				link_send(&lc.l, buf, r);
+				lc.sent += r;
+				lc.frames++;
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long window = 4;
+	int t1 = 250;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "Ca:kw:t:")) != -1) {
+		switch (opt) {
+		case 'C': frame_set_codec(FRAME_CODEC_COBS); break;
+		case 'a':
+			if (serial_set_node(optarg))
+				goto usage;
+			break;
+		case 'k':
+			frame_set_credits(CREDIT_BOARD_SLOTS,
+					CREDIT_BOARD_BYTES);
+			break;
+		case 'w': window = strtoul(optarg, NULL, 0); break;
+		case 't': t1 = atoi(optarg); break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (argc - optind != 1 || !window || window > LINK_WINDOW_MAX
+			|| t1 <= 0 || t1 > UINT16_MAX / 2)
+		goto usage;
+
+	lc.tty = serial_open(argv[optind]);
+	if (lc.tty < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	link_init(&lc.l, lc_xmit, window, t1);
+	if (lc_run(t1)) {
+		fprintf(stderr, "linkcat: %s\n", strerror(errno));
+		ret = 1;
+	}
+	close(lc.tty);
+
+	fprintf(stderr, "%lu bytes sent, %lu echoed, %lu I frames (%lu sent "
+			"again), %lu REJ, %lu RNR\n", lc.sent, lc.got,
+			lc.i_frames, lc.i_frames - lc.frames, lc.rej, lc.rnr);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-C] [-a node] [-k] [-w window] "
+			"[-t t1_ms] tty\n", argv[0]);
+	return 2;
+}
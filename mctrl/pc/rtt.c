@@ -0,0 +1,657 @@
+/* Round trip latency, jitter and throughput of the mctrl host link.
+ *
+ * usage: rtt [-C] [-H] [-S] [-a node] [-k] [-b baud] [-c chan] [-n count]
+ *            [-r rate] [-s sizes] [-t timeout_ms] [-w window] (tty | -l)
+ *
+ * Sends `count` frames of each of `sizes` (comma separated frame lengths,
+ * the channel byte included, 8,16,28 by default, over 255 needs FRAME_JUMBO
+ * on the board) on `chan` (telem by default), which the firmware of
+ * ../main.c echoes back. Each frame is
+ *	[chan] [seq:16] [sent_us:32] [pattern...]
+ * so the round trip is timed from the echo itself, and a frame which comes
+ * back altered, twice or after `timeout_ms` (1000) counts as bad. At most
+ * `window` (1) frames are in flight at once, and frames are offered at
+ * `rate` per second, as fast as the window allows if 0 (the default).
+ * For each size it reports:
+ *  - sent, lost, bad
+ *  - p50_us, p99_us, max_us: percentiles of the round trip
+ *  - jitter_us: mean difference between successive round trips
+ *  - B/s:  frame bytes echoed per second
+ *  - line: the wire bytes of those, each way, as a share of the line rate
+ *          (counting one flag per frame, as when sent back to back)
+ * and with -H a histogram of the round trips in power of 2 buckets. With -S
+ * the board's link stats (RPC_LINK_STATS, proto.h) are cleared before and
+ * shown after each size: errors, drops and how full its rings got.
+ *
+ * With a tty, -b first moves the link to `baud` (as speed does, for a
+ * 16MHz board). With -l the other end is a pty instead, behind which a
+ * child process runs ../frame_async.c and ../chan.c as built for the
+ * board (frame_conf.h), its ISRs clocked at `baud` (38400 by default)
+ * characters of 11 bits, and the echo loop of main.c. That shows what a
+ * change to the framing code does to the numbers before it is flashed,
+ * though the pty adds some latency of its own.
+ *
+ * -C talks COBS, for a board built with FRAME_COBS, -a to `node` of a board
+ * built with FRAME_ADDR, and -k keeps to the credits of one built with
+ * FRAME_CREDITS, which then hold frames back as the window does. -l follows
+ * the build in all three.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*** The board (-l) ***/
+static int sim_rx_byte;    /* host => firmware, for the next rx isr */
+static int sim_tx_byte;    /* firmware => host, -1 when the isr sent none */
+
+#define FRAME_SIM_GETC()      (sim_rx_byte)
+#define FRAME_SIM_PUTC(byte)  (sim_tx_byte = (uint8_t)(byte))
+
+#include "../frame_async.c"
+#include "../proto.h"
+#include "../chan.h"
+#include "../rpc.h"
+#include "frame_buf.h"
+#include "serial.h"
+
+/* bits per character: start, 8 data, parity, stop */
+#define RTT_CHAR_BITS 11
+/* the board's clock, for -b */
+#define RTT_F_CPU 16000000UL
+/* largest frame sent, and received (the board takes more than 255 bytes
+ * with FRAME_JUMBO only) */
+#define FRAME_MAX 1024
+
+static uint64_t ns_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void board_echo(uint8_t chan, const struct frame_seg *seg)
+{
+	chan_sendv(chan, seg, 2);
+}
+
+static const struct rpc_cmd board_cmds[] RPC_TABLE = {
+	[RPC_LINK_STATS] = { rpc_link_stats, 1 },
+};
+
+/* runs the firmware on the master side of the pty until the host end is
+ * closed. Every character time the rx isr gets the next byte the host
+ * wrote (if any), the tx isr may send one, and the main loop runs once. */
+__attribute__((noreturn))
+static void board_run(int fd, unsigned long baud)
+{
+	uint8_t in[256], out[256];
+	size_t in_len = 0, in_pos = 0, out_len = 0;
+	uint64_t char_ns = RTT_CHAR_BITS * 1000000000ULL / baud;
+	uint64_t next = ns_now();
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	frame_init();
+	chan_init();
+	chan_set_recv(CHAN_CONSOLE, board_echo);
+	chan_set_recv(CHAN_TELEM, board_echo);
+	chan_set_recv(CHAN_RPC, rpc_recv);
+	rpc_init(board_cmds, ARRAY_SIZE(board_cmds));
+
+	for (;;) {
+		if (in_pos == in_len) {
+			ssize_t r = read(fd, in, sizeof(in));
+			if (!r || (r < 0 && errno != EAGAIN && errno != EINTR))
+				_exit(0);
+			in_pos = 0;
+			in_len = r > 0 ? r : 0;
+		}
+
+		/* all quiet: wait for the host rather than spin */
+		if (in_pos == in_len && !out_len && frame_tx_drained()
+				&& !frame_recv_have_pkt()) {
+			struct pollfd p = { .fd = fd, .events = POLLIN };
+			if (poll(&p, 1, -1) < 0 && errno != EINTR)
+				_exit(1);
+			next = ns_now();
+			continue;
+		}
+
+		uint64_t now = ns_now();
+		while (next <= now && out_len < sizeof(out)) {
+			if (in_pos < in_len) {
+				sim_rx_byte = in[in_pos++];
+				frame_rx_isr();
+			}
+			/* as UDRIE would, going off after the last flag */
+			sim_tx_byte = -1;
+			if (!frame_tx_drained())
+				frame_tx_isr();
+			if (sim_tx_byte >= 0)
+				out[out_len++] = sim_tx_byte;
+			chan_poll();
+			next += char_ns;
+		}
+
+		if (out_len) {
+			ssize_t w = write(fd, out, out_len);
+			if (w < 0 && errno != EAGAIN && errno != EINTR)
+				_exit(0);
+			if (w > 0) {
+				memmove(out, out + w, out_len - w);
+				out_len -= w;
+			}
+		}
+
+		struct timespec ts = {
+			.tv_sec = next / 1000000000ULL,
+			.tv_nsec = next % 1000000000ULL,
+		};
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+}
+
+/* return: the host end of a pty with board_run() behind it, -1 with errno
+ * set on error */
+static int board_open(unsigned long baud, pid_t *pid)
+{
+	int m = posix_openpt(O_RDWR | O_NOCTTY);
+	if (m < 0)
+		return -1;
+	if (grantpt(m) || unlockpt(m))
+		goto err;
+
+	int fd = serial_open(ptsname(m));
+	if (fd < 0)
+		goto err;
+
+	*pid = fork();
+	if (*pid < 0) {
+		close(fd);
+		goto err;
+	}
+	if (!*pid) {
+		close(fd);
+		board_run(m, baud);
+	}
+	close(m);
+	return fd;
+
+err:
+	{
+		int e = errno;
+		close(m);
+		errno = e;
+	}
+	return -1;
+}
+
+/*** The host ***/
+#define RTT_HDR_LEN 7
+#define RTT_SEQS 65536
+/* -H buckets: [0, 2) us, [2, 4), ... [2^(n-1), inf) */
+#define RTT_HIST_LEN 24
+
+struct rtt {
+	int fd;
+	uint8_t chan;
+	unsigned long count, rate, window;
+	unsigned long timeout_us;
+	unsigned long baud;     /* for line, 0 if not known */
+
+	/* the size being run */
+	uint16_t size;
+	size_t wire_len;        /* encoded length of one frame, less a flag */
+	unsigned long sent, got, lost, bad;
+	unsigned long inflight;
+	uint16_t seq, oldest;   /* next to send, oldest maybe in flight */
+	uint32_t *us;           /* round trips of the frames back, got long */
+	uint64_t start_ns, end_ns;
+
+	/* the answer to the last RPC_LINK_STATS (-S) */
+	uint8_t stats_tag;
+	bool stats_got;
+	uint8_t stats[RPC_LINK_STATS_LEN];
+
+	bool pending[RTT_SEQS];
+	uint64_t sent_ns[RTT_SEQS];
+};
+
+static uint8_t rtt_pattern(uint16_t seq, uint16_t i)
+{
+	return seq * 13 + i * 7;
+}
+
+static int rtt_send(struct rtt *t)
+{
+	uint8_t f[FRAME_MAX];
+	uint64_t now = ns_now();
+	uint32_t us = now / 1000;
+	uint16_t i;
+
+	f[0] = t->chan;
+	f[1] = t->seq >> 8;
+	f[2] = t->seq;
+	f[3] = us >> 24;
+	f[4] = us >> 16;
+	f[5] = us >> 8;
+	f[6] = us;
+	for (i = RTT_HDR_LEN; i < t->size; i++)
+		f[i] = rtt_pattern(t->seq, i);
+
+	if (frame_write(t->fd, f, t->size) < 0)
+		return -1;
+
+	t->pending[t->seq] = true;
+	t->sent_ns[t->seq] = now;
+	t->seq++;
+	t->sent++;
+	t->inflight++;
+	return 0;
+}
+
+static void rtt_frame(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct rtt *t = ctx;
+	uint32_t now = ns_now() / 1000;
+	size_t i;
+
+	if (len == 1 + RPC_HDR_LEN + 1 + RPC_LINK_STATS_LEN
+			&& frame[0] == CHAN_RPC && frame[1] == RPC_LINK_STATS
+			&& frame[2] == t->stats_tag && frame[3] == RPC_OK) {
+		memcpy(t->stats, frame + 4, sizeof(t->stats));
+		t->stats_got = true;
+		return;
+	}
+
+	/* the board's own output, if any */
+	if (!len || frame[0] != t->chan)
+		return;
+
+	if (len != t->size) {
+		t->bad++;
+		return;
+	}
+	uint16_t seq = frame[1] << 8 | frame[2];
+	if (!t->pending[seq]) {
+		t->bad++;
+		return;
+	}
+	for (i = RTT_HDR_LEN; i < len; i++) {
+		if (frame[i] != rtt_pattern(seq, i)) {
+			t->bad++;
+			return;
+		}
+	}
+
+	uint32_t sent = (uint32_t)frame[3] << 24 | (uint32_t)frame[4] << 16
+		| frame[5] << 8 | frame[6];
+	t->pending[seq] = false;
+	t->inflight--;
+	t->us[t->got++] = now - sent;
+	t->end_ns = ns_now();
+}
+
+/* count frames which have been out longer than timeout_us as lost */
+static void rtt_expire(struct rtt *t, uint64_t now)
+{
+	for (; t->oldest != t->seq; t->oldest++) {
+		if (!t->pending[t->oldest])
+			continue;
+		if (now - t->sent_ns[t->oldest] < t->timeout_us * 1000)
+			break;
+		t->pending[t->oldest] = false;
+		t->inflight--;
+		t->lost++;
+	}
+}
+
+/* wait up to wait_ns for input and decode it.
+ * return: 0, or -1 with errno set on error */
+static int rtt_read(struct rtt *t, struct frame_dec *dec, uint64_t wait_ns)
+{
+	struct timespec ts = {
+		.tv_sec = wait_ns / 1000000000ULL,
+		.tv_nsec = wait_ns % 1000000000ULL,
+	};
+	struct pollfd p = { .fd = t->fd, .events = POLLIN };
+	int r = ppoll(&p, 1, &ts, NULL);
+	if (r < 0)
+		return errno == EINTR ? 0 : -1;
+	if (!r)
+		return 0;
+
+	ssize_t n = frame_dec_read(dec, t->fd, rtt_frame, t);
+	if (!n) {
+		errno = EIO;
+		return -1;
+	}
+	if (n < 0 && errno != EAGAIN && errno != EINTR)
+		return -1;
+	return 0;
+}
+
+/* return: 0 once all frames of this size are back or lost, -1 with errno
+ *         set on error */
+static int rtt_run(struct rtt *t, struct frame_dec *dec)
+{
+	uint64_t gap_ns = t->rate ? 1000000000ULL / t->rate : 0;
+	uint64_t next = ns_now();
+
+	t->start_ns = t->end_ns = next;
+	while (t->sent < t->count || t->inflight) {
+		uint64_t now = ns_now();
+		rtt_expire(t, now);
+
+		/* the board's credits (-k), a frame it has no room for is
+		 * held back until it says it has */
+		bool room = t->inflight < t->window
+			&& frame_write_ready(t->size);
+		if (t->sent < t->count && room && now >= next) {
+			if (rtt_send(t))
+				return -1;
+			/* when held up by the window, don't make up for it in
+			 * a burst */
+			next += gap_ns;
+			if (next < now)
+				next = now;
+			continue;
+		}
+
+		/* sleep until a frame comes in, the next one may be sent, or
+		 * the oldest one times out */
+		uint64_t wake = UINT64_MAX;
+		if (t->sent < t->count && room)
+			wake = next;
+		else if (t->sent < t->count && !t->inflight) {
+			/* only credits to wait for, which the board sends
+			 * as soon as it frees room */
+			if (now - t->end_ns >= t->timeout_us * 1000ULL) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+			wake = t->end_ns + t->timeout_us * 1000ULL;
+		}
+		if (t->inflight) {
+			uint64_t exp = t->sent_ns[t->oldest]
+				+ t->timeout_us * 1000ULL;
+			if (exp < wake)
+				wake = exp;
+		}
+		if (rtt_read(t, dec, wake > now ? wake - now : 0))
+			return -1;
+	}
+	return 0;
+}
+
+/* ask the board for its link stats (-S), zeroing them after if clear.
+ * return: 0 with them in t->stats, -1 with errno set */
+static int rtt_link_stats(struct rtt *t, struct frame_dec *dec, bool clear)
+{
+	const uint8_t req[] = {
+		CHAN_RPC, RPC_LINK_STATS, ++t->stats_tag, clear,
+	};
+	uint64_t end = ns_now() + t->timeout_us * 1000ULL;
+
+	t->stats_got = false;
+	while (!frame_write_ready(sizeof(req))) {
+		uint64_t now = ns_now();
+		if (now >= end) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if (rtt_read(t, dec, end - now))
+			return -1;
+	}
+	if (frame_write(t->fd, req, sizeof(req)) < 0)
+		return -1;
+	while (!t->stats_got) {
+		uint64_t now = ns_now();
+		if (now >= end) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if (rtt_read(t, dec, end - now))
+			return -1;
+	}
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void rtt_report(struct rtt *t, bool hist)
+{
+	double secs = (t->end_ns - t->start_ns) / 1e9;
+	double jitter = 0;
+	unsigned long i;
+
+	/* in the order they came back */
+	for (i = 1; i < t->got; i++) {
+		uint32_t a = t->us[i - 1], b = t->us[i];
+		jitter += a > b ? a - b : b - a;
+	}
+	if (t->got > 1)
+		jitter /= t->got - 1;
+
+	printf("%4u %7lu %6lu %5lu", t->size, t->sent, t->lost, t->bad);
+	if (!t->got) {
+		printf("\n");
+		return;
+	}
+
+	qsort(t->us, t->got, sizeof(*t->us), cmp_u32);
+	printf(" %8u %8u %8u %9.0f", t->us[(t->got - 1) * 50 / 100],
+			t->us[(t->got - 1) * 99 / 100], t->us[t->got - 1],
+			jitter);
+	if (secs > 0) {
+		printf(" %8.0f", t->got * t->size / secs);
+		if (t->baud)
+			printf(" %5.1f%%", 100.0 * t->got * t->wire_len
+					* RTT_CHAR_BITS / secs / t->baud);
+	}
+	printf("\n");
+
+	if (!hist)
+		return;
+
+	unsigned long h[RTT_HIST_LEN] = { 0 };
+	unsigned b, top = 0;
+	for (i = 0; i < t->got; i++) {
+		for (b = 0; b < RTT_HIST_LEN - 1 && t->us[i] >> (b + 1); b++)
+			;
+		h[b]++;
+		if (b > top)
+			top = b;
+	}
+	for (b = 0; b <= top; b++) {
+		if (!h[b] && (!b || !h[b - 1]))
+			continue;
+		printf("     %8lu us %7lu ", b ? 1UL << b : 0, h[b]);
+		for (i = 0; i < h[b] * 50 / t->got; i++)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+static void rtt_report_stats(const struct rtt *t)
+{
+	const uint8_t *s = t->stats;
+	printf("     link rx: fe %u dor %u upe %u crc %u no_space %u "
+			"no_slot %u, tx: drops %u isr_idle %u\n",
+			s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]);
+	printf("     high water rx: %u bytes %u pkts, tx: %u bytes %u pkts\n",
+			s[8] << 8 | s[9], s[10], s[11] << 8 | s[12], s[13]);
+}
+
+/* return: number of sizes parsed into sizes, -1 if s isn't a list of them */
+static int parse_sizes(const char *s, uint16_t *sizes, int max)
+{
+	int n = 0;
+	for (;;) {
+		char *end;
+		unsigned long v = strtoul(s, &end, 0);
+		if (end == s || v < RTT_HDR_LEN || v > FRAME_MAX || n == max)
+			return -1;
+		sizes[n++] = v;
+		if (!*end)
+			return n;
+		if (*end != ',')
+			return -1;
+		s = end + 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static struct rtt t;
+	uint16_t sizes[16] = { 8, 16, 28 };
+	int nsizes = 3;
+	unsigned long baud = 0;
+	bool loop = false, hist = false, stats = false;
+	pid_t pid = 0;
+	int opt, i, ret = 0;
+
+	t.chan = CHAN_TELEM;
+	t.count = 200;
+	t.window = 1;
+	t.timeout_us = 1000000;
+
+	while ((opt = getopt(argc, argv, "CHSa:kb:c:ln:r:s:t:w:")) != -1) {
+		switch (opt) {
+		case 'C': frame_set_codec(FRAME_CODEC_COBS); break;
+		case 'H': hist = true; break;
+		case 'S': stats = true; break;
+		case 'a':
+			if (serial_set_node(optarg))
+				goto usage;
+			break;
+		case 'k':
+			frame_set_credits(CREDIT_BOARD_SLOTS,
+					CREDIT_BOARD_BYTES);
+			break;
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 'c': t.chan = strtoul(optarg, NULL, 0); break;
+		case 'l': loop = true; break;
+		case 'n': t.count = strtoul(optarg, NULL, 0); break;
+		case 'r': t.rate = strtoul(optarg, NULL, 0); break;
+		case 's':
+			nsizes = parse_sizes(optarg, sizes,
+					sizeof(sizes) / sizeof(*sizes));
+			if (nsizes < 0)
+				goto usage;
+			break;
+		case 't': t.timeout_us = strtoul(optarg, NULL, 0) * 1000; break;
+		case 'w': t.window = strtoul(optarg, NULL, 0); break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (argc - optind != !loop || !t.count || !t.window
+			|| t.window >= RTT_SEQS || !t.timeout_us
+			|| t.chan >= CHAN_COUNT)
+		goto usage;
+
+	if (loop) {
+		if (F_COBS_EN)
+			frame_set_codec(FRAME_CODEC_COBS);
+		if (F_ADDR_EN)
+			frame_set_dest(frame_var(usart0, addr));
+		if (F_CREDIT_LEN)
+			frame_set_credits(ARRAY_SIZE(frame_var(usart0, rx).p_idx)
+					- 2, sizeof(frame_var(usart0, rx).buf) - 1);
+		t.baud = baud ? baud : SERIAL_BAUD_DEFAULT;
+		t.fd = board_open(t.baud, &pid);
+		if (t.fd < 0) {
+			fprintf(stderr, "pty: %s\n", strerror(errno));
+			return 1;
+		}
+	} else {
+		t.fd = serial_open(argv[optind]);
+		if (t.fd < 0) {
+			fprintf(stderr, "%s: %s\n", argv[optind],
+					strerror(errno));
+			return 1;
+		}
+		t.baud = SERIAL_BAUD_DEFAULT;
+	}
+
+	uint8_t dec_buf[FRAME_MAX + FRAME_CRC_LEN];
+	struct frame_dec dec;
+	frame_dec_init(&dec, dec_buf, sizeof(dec_buf));
+
+	if (!loop && baud) {
+		uint16_t ubrr;
+		bool u2x;
+		serial_baud_ubrr(RTT_F_CPU, baud, &ubrr, &u2x);
+		if (serial_negotiate(t.fd, &dec, RTT_F_CPU, ubrr, u2x, 500)) {
+			fprintf(stderr, "negotiation failed: %s\n",
+					strerror(errno));
+			close(t.fd);
+			return 1;
+		}
+		t.baud = serial_ubrr_baud(RTT_F_CPU, ubrr, u2x);
+	}
+
+	t.us = malloc(t.count * sizeof(*t.us));
+	if (!t.us) {
+		fprintf(stderr, "out of memory\n");
+		ret = 1;
+		goto out;
+	}
+
+	printf("%lu baud, window %lu, %lu/s\n", t.baud, t.window, t.rate);
+	printf("size    sent   lost   bad   p50_us   p99_us   max_us "
+			"jitter_us      B/s  line\n");
+	for (i = 0; i < nsizes; i++) {
+		uint8_t enc[FRAME_ENC_MAX(FRAME_MAX)], f[FRAME_MAX];
+		uint16_t j;
+
+		/* near enough for all of them, the header varies little */
+		t.size = sizes[i];
+		f[0] = t.chan;
+		for (j = 1; j < t.size; j++)
+			f[j] = j < RTT_HDR_LEN ? 1 : rtt_pattern(0, j);
+		/* back to back frames share a flag */
+		t.wire_len = frame_encode(enc, f, t.size) - 1;
+		t.sent = t.got = t.lost = t.bad = 0;
+		t.oldest = t.seq;
+		if ((stats && rtt_link_stats(&t, &dec, true))
+				|| rtt_run(&t, &dec)
+				|| (stats && rtt_link_stats(&t, &dec, false))) {
+			fprintf(stderr, "rtt: %s\n", strerror(errno));
+			ret = 1;
+			break;
+		}
+		rtt_report(&t, hist);
+		if (stats)
+			rtt_report_stats(&t);
+	}
+	free(t.us);
+
+out:
+	close(t.fd);
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-C] [-H] [-S] [-a node] [-k] [-b baud] "
+			"[-c chan] [-n count] [-r rate] [-s sizes] "
+			"[-t timeout_ms] [-w window] (tty | -l)\n", argv[0]);
+	return 2;
+}
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../proto.h"
+#include "../link.h"
+#include "frame_buf.h"
+#include "serial.h"
+
+static const struct {
+	unsigned long baud;
+	speed_t speed;
+} rates[] = {
+	{ 9600, B9600 },
+	{ 19200, B19200 },
+	{ 38400, B38400 },
+	{ 57600, B57600 },
+	{ 115200, B115200 },
+	{ 230400, B230400 },
+#ifdef B460800
+	{ 460800, B460800 },
+#endif
+#ifdef B500000
+	{ 500000, B500000 },
+#endif
+#ifdef B576000
+	{ 576000, B576000 },
+#endif
+#ifdef B921600
+	{ 921600, B921600 },
+#endif
+#ifdef B1000000
+	{ 1000000, B1000000 },
+#endif
+#ifdef B2000000
+	{ 2000000, B2000000 },
+#endif
+};
+
+/* return: index into rates of the one within 3% of baud, -1 if none is */
+static int rate_find(unsigned long baud)
+{
+	size_t i;
+	for (i = 0; i < sizeof(rates) / sizeof(*rates); i++) {
+		unsigned long r = rates[i].baud;
+		unsigned long diff = r > baud ? r - baud : baud - r;
+		if (diff * 100 <= r * 3)
+			return i;
+	}
+	return -1;
+}
+
+int serial_set_baud(int fd, unsigned long baud)
+{
+	struct termios t;
+	int i = rate_find(baud);
+	if (i < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (tcgetattr(fd, &t))
+		return -1;
+	cfsetispeed(&t, rates[i].speed);
+	cfsetospeed(&t, rates[i].speed);
+	return tcsetattr(fd, TCSANOW, &t);
+}
+
+int serial_open(const char *path)
+{
+	struct termios t;
+	int fd = open(path, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+
+	if (tcgetattr(fd, &t))
+		goto err;
+
+	cfmakeraw(&t);
+	t.c_cflag &= ~(CSTOPB | CRTSCTS);
+	t.c_cflag |= PARENB | PARODD | CLOCAL | CREAD;
+	t.c_cc[VMIN] = 0;
+	t.c_cc[VTIME] = 0;
+
+	if (tcsetattr(fd, TCSANOW, &t)
+			|| serial_set_baud(fd, SERIAL_BAUD_DEFAULT))
+		goto err;
+	return fd;
+
+err:
+	{
+		int e = errno;
+		close(fd);
+		errno = e;
+	}
+	return -1;
+}
+
+int serial_set_node(const char *node)
+{
+	char *end;
+	unsigned long n = strtoul(node, &end, 0);
+	if (end == node || *end || n > FRAME_ADDR_NODE_MAX)
+		return -1;
+	frame_set_dest(FRAME_ADDR8(n, 0));
+	return 0;
+}
+
+unsigned long serial_ubrr_baud(unsigned long f_cpu, uint16_t ubrr, bool u2x)
+{
+	return f_cpu / ((u2x ? 8UL : 16UL) * (ubrr + 1UL));
+}
+
+void serial_baud_ubrr(unsigned long f_cpu, unsigned long baud,
+		uint16_t *ubrr, bool *u2x)
+{
+	unsigned long best_err = (unsigned long)-1;
+	int x;
+
+	for (x = 0; x < 2; x++) {
+		unsigned long div = (x ? 8UL : 16UL) * baud;
+		unsigned long u = (f_cpu + div / 2) / div;
+		if (u)
+			u--;
+		if (u > BAUD_UBRR_MAX)
+			u = BAUD_UBRR_MAX;
+
+		unsigned long got = serial_ubrr_baud(f_cpu, u, x);
+		unsigned long err = got > baud ? got - baud : baud - got;
+		/* without U2X the receiver samples more, prefer it on ties */
+		if (err < best_err) {
+			best_err = err;
+			*ubrr = u;
+			*u2x = x;
+		}
+	}
+}
+
+/*** Negotiation ***/
+struct xid_wait {
+	bool got;
+	uint8_t xid[BAUD_XID_LEN];
+};
+
+static void xid_frame(void *ctx, const uint8_t *frame, size_t len)
+{
+	struct xid_wait *w = ctx;
+	if (len == 1 + BAUD_XID_LEN && frame[0] == CHAN_LINK
+			&& (frame[1] & ~LINK_PF) == LINK_U_XID) {
+		memcpy(w->xid, frame + 1, BAUD_XID_LEN);
+		w->got = true;
+	}
+}
+
+static long ms_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* send the XID proposing ubrr/u2x and wait up to wait_ms for the answer.
+ * return: 0 with the answer in xid, -1 on timeout or error. */
+static int xid_xchg(int fd, struct frame_dec *d, uint16_t ubrr, bool u2x,
+		int wait_ms, uint8_t *xid)
+{
+	const uint8_t prop[1 + BAUD_XID_LEN] = {
+		CHAN_LINK,
+		LINK_U_XID | LINK_PF,
+		(uint8_t)(ubrr >> 8), (uint8_t)ubrr,
+		u2x ? BAUD_F_U2X : 0,
+	};
+	struct xid_wait w = { .got = false };
+	long end = ms_now() + wait_ms;
+
+	if (frame_write(fd, prop, sizeof(prop)) < 0)
+		return -1;
+
+	for (;;) {
+		long left = end - ms_now();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		struct pollfd p = { .fd = fd, .events = POLLIN };
+		int r = poll(&p, 1, left);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (!r)
+			continue;
+
+		if (frame_dec_read(d, fd, xid_frame, &w) < 0
+				&& errno != EAGAIN && errno != EINTR)
+			return -1;
+		if (w.got) {
+			memcpy(xid, w.xid, sizeof(w.xid));
+			return 0;
+		}
+	}
+}
+
+static bool xid_is(const uint8_t *xid, uint16_t ubrr, bool u2x)
+{
+	return xid[1] == (uint8_t)(ubrr >> 8) && xid[2] == (uint8_t)ubrr
+		&& !(xid[3] & BAUD_F_U2X) == !u2x;
+}
+
+int serial_negotiate(int fd, struct frame_dec *d, unsigned long f_cpu,
+		uint16_t ubrr, bool u2x, int timeout_ms)
+{
+	uint8_t xid[BAUD_XID_LEN];
+	unsigned long baud = serial_ubrr_baud(f_cpu, ubrr, u2x);
+
+	/* don't ask the board for something we can't follow it to */
+	if (ubrr > BAUD_UBRR_MAX || rate_find(baud) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (xid_xchg(fd, d, ubrr, u2x, timeout_ms, xid))
+		return -1;
+	if (!xid_is(xid, ubrr, u2x)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the board switches once its answer is out, and only looks for that
+	 * every so often, so keep confirming until it answers */
+	if (tcdrain(fd) || serial_set_baud(fd, baud))
+		goto fallback;
+	tcflush(fd, TCIFLUSH);
+	d->started = false;
+
+	long end = ms_now() + timeout_ms;
+	while (ms_now() < end) {
+		if (!xid_xchg(fd, d, ubrr, u2x, timeout_ms / 8 + 1, xid)
+				&& xid_is(xid, ubrr, u2x))
+			return 0;
+	}
+	errno = ETIMEDOUT;
+
+fallback:
+	{
+		int e = errno;
+		tcdrain(fd);
+		serial_set_baud(fd, SERIAL_BAUD_DEFAULT);
+		tcflush(fd, TCIFLUSH);
+		d->started = false;
+		errno = e;
+	}
+	return -1;
+}
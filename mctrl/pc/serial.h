@@ -0,0 +1,50 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_ 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_buf.h"
+
+/* the board's FRAME_BAUD, which it starts with and falls back to */
+#define SERIAL_BAUD_DEFAULT 38400
+
+/* open a tty raw, 8 data bits, odd parity, 1 stop bit (as frame_init() sets
+ * up the board) at SERIAL_BAUD_DEFAULT.
+ * return: the fd, or -1 with errno set.
+ */
+int serial_open(const char *path);
+
+/* talk to node `node` (a number, 0 .. FRAME_ADDR_NODE_MAX) of a board
+ * built with FRAME_ADDR, see frame_set_dest(). For the tools' -a.
+ * return: 0, or -1 if node isn't one.
+ */
+int serial_set_node(const char *node);
+
+/* switch fd to the termios rate nearest baud, if within 3% of it.
+ * return: 0, or -1 with errno set (EINVAL if there is no close rate).
+ */
+int serial_set_baud(int fd, unsigned long baud);
+
+/* the baud rate a UBRR/U2X setting gives on a part clocked at f_cpu */
+unsigned long serial_ubrr_baud(unsigned long f_cpu, uint16_t ubrr, bool u2x);
+
+/* the UBRR/U2X setting closest to baud on a part clocked at f_cpu. */
+void serial_baud_ubrr(unsigned long f_cpu, unsigned long baud,
+		uint16_t *ubrr, bool *u2x);
+
+/* negotiate the board's link (see ../baud.h) over to ubrr/u2x and switch
+ * fd to match. Other frames arriving in the meantime are dropped.
+ *
+ * d: decoder for fd.
+ * timeout_ms: how long to wait for each answer. Should be shorter than the
+ *             board's fallback timeout.
+ * return: 0 once the link is up at the new speed, -1 with errno set
+ *         otherwise: EINVAL if the board (or termios) can't do the speed,
+ *         fd is then unchanged; ETIMEDOUT if the board went quiet, fd is
+ *         then back at SERIAL_BAUD_DEFAULT, as the board will be.
+ */
+int serial_negotiate(int fd, struct frame_dec *d, unsigned long f_cpu,
+		uint16_t ubrr, bool u2x, int timeout_ms);
+
+#endif
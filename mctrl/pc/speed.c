@@ -0,0 +1,86 @@
+/* Move the mctrl host link to another speed.
+ *
+ * usage: speed [-C] [-a node] [-k] [-F f_cpu] [-t timeout_ms] tty baud
+ *
+ * Proposes the UBRR/U2X setting closest to `baud` for a board clocked at
+ * f_cpu (16MHz by default) and follows the board over to it, see
+ * ../baud.h. The board only falls back to its default speed when the new
+ * one is not confirmed; once it is, the board stays there until it is reset
+ * or moved again, so later opens of the tty must use the new speed. -C
+ * talks COBS, for a board built with FRAME_COBS, -a to `node` of a board
+ * built with FRAME_ADDR and -k keeps to the credits of one built with
+ * FRAME_CREDITS.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "frame_buf.h"
+#include "serial.h"
+
+int main(int argc, char **argv)
+{
+	unsigned long f_cpu = 16000000;
+	int timeout_ms = 500;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "Ca:kF:t:")) != -1) {
+		switch (opt) {
+		case 'C': frame_set_codec(FRAME_CODEC_COBS); break;
+		case 'a':
+			if (serial_set_node(optarg))
+				goto usage;
+			break;
+		case 'k':
+			frame_set_credits(CREDIT_BOARD_SLOTS,
+					CREDIT_BOARD_BYTES);
+			break;
+		case 'F': f_cpu = strtoul(optarg, NULL, 0); break;
+		case 't': timeout_ms = atoi(optarg); break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (argc - optind != 2)
+		goto usage;
+
+	unsigned long baud = strtoul(argv[optind + 1], NULL, 0);
+	if (!baud || !f_cpu || timeout_ms <= 0)
+		goto usage;
+
+	uint16_t ubrr;
+	bool u2x;
+	serial_baud_ubrr(f_cpu, baud, &ubrr, &u2x);
+	unsigned long got = serial_ubrr_baud(f_cpu, ubrr, u2x);
+	printf("ubrr %u%s: %lu baud\n", ubrr, u2x ? " u2x" : "", got);
+
+	int fd = serial_open(argv[optind]);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	uint8_t buf[64];
+	struct frame_dec d;
+	frame_dec_init(&d, buf, sizeof(buf));
+
+	if (serial_negotiate(fd, &d, f_cpu, ubrr, u2x, timeout_ms)) {
+		fprintf(stderr, "negotiation failed: %s\n", strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	printf("link up at %lu baud\n", got);
+	close(fd);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-C] [-a node] [-k] [-F f_cpu] "
+			"[-t timeout_ms] tty baud\n", argv[0]);
+	return 2;
+}
@@ -1,9 +1,100 @@
 #ifndef PROTO_H_
 #define PROTO_H_
 
+/* Frames on the host link:
+ *  [chan:8] [payload:n]
+ * chan picks the stream the frame belongs to (chan.h, pc/chanmux.c). */
+#define CHAN_LINK    0 /* HDLC control frames: link.h, speed negotiation */
+#define CHAN_CONSOLE 1 /* text, debug output from the board */
+#define CHAN_RPC     2 /* commands and their replies, rpc.h */
+#define CHAN_TELEM   3
+#define CHAN_BULK    4 /* fragments of large messages, frag.h */
+#define CHAN_FAST    5 /* one byte commands acted on at once, FAST_* */
+#define CHAN_COUNT   6
+
+/* fast frames on CHAN_FAST: [op:8]
+ * with FRAME_FAST they are handled from the RX ISR (chan_set_fast()). */
+#define FAST_STOP      0x00 /* motors off */
+#define FAST_HEARTBEAT 0x01 /* the host is alive, see ctl.h */
+
 #define START_BYTE ((uint8_t)0x7e)
 #define RESET_BYTE ((uint8_t)0x7f)
 #define ESC_BYTE   ((uint8_t)0x7d)
 #define ESC_MASK   ((uint8_t)0x20)
 
-#endif
+/* with FRAME_COBS, frames are instead delimited by zeros and COBS encoded:
+ *  [0x00] [code:8] [block:code-1] [code:8] ... [0x00]
+ * each block is followed by a zero in the decoded data, except for the last
+ * one and those with code 0xff (COBS_BLOCK_MAX bytes). */
+#define COBS_DELIM     ((uint8_t)0x00)
+#define COBS_BLOCK_MAX 254
+
+/* bytes of CRC-16/CCITT trailing the data of each frame */
+#define FRAME_CRC_LEN 2
+
+/* addr8: [multicast:1] [node addr:6] ['1':1]
+ * nodes 0x3e and 0x3f are reserved, their addresses would be ESC_BYTE and
+ * RESET_BYTE. */
+#define FRAME_ADDR_MCAST    ((uint8_t)0x80)
+#define FRAME_ADDR_NODE_MAX 0x3d
+#define FRAME_ADDR8(node, mcast) \
+	((uint8_t)(((mcast) ? FRAME_ADDR_MCAST : 0) | ((node) << 1) | 1))
+
+/* with FRAME_CREDITS, bytes of credits following addr in the frames from
+ * the board: [rx_frames:8] [free_slots:8] [free_bytes:8], see frame_gen.h */
+#define FRAME_CREDIT_LEN 3
+
+/* speed negotiation (baud.h), an HDLC XID frame on CHAN_LINK:
+ *  [ctrl:8] [ubrr:16] [flags:8]
+ * ctrl is LINK_U_XID (link.h) with P set by the host, F in the answer. */
+#define BAUD_XID_LEN   4
+#define BAUD_F_U2X     0x01
+#define BAUD_UBRR_MAX  0x0fff
+
+/* fragments of a larger message (frag.h), HDLC UI frames on CHAN_BULK:
+ *  [ctrl:8] [msg:8] [last:1 seq:7] [data:n]
+ * ctrl is LINK_U_UI (link.h). msg numbers the messages of a sender, seq the
+ * fragments of a message from 0, last is set on its final fragment. */
+#define FRAG_HDR_LEN   3
+#define FRAG_LAST      0x80
+#define FRAG_SEQ_MASK  0x7f
+
+/* remote procedure calls (rpc.h) on CHAN_RPC:
+ *  request: [cmd:8] [tag:8] [args:n]
+ *  reply:   [cmd:8] [tag:8] [status:8] [ret:n]
+ * tag is the host's to match replies to requests, and is echoed untouched.
+ * ret is only present with RPC_OK. Multibyte values are big endian, speeds
+ * and pid values signed. */
+#define RPC_HDR_LEN    2
+
+#define RPC_OK         0
+#define RPC_E_CMD      1 /* no such command */
+#define RPC_E_LEN      2 /* args of the wrong length */
+#define RPC_E_ARG      3 /* an argument out of range */
+
+/* [data:n] -> [data:n] */
+#define RPC_PING       0x00
+/* -> [uptime_ms:32] [chan_drops:8] [crc_errors:8] [motors_enabled:8] */
+#define RPC_STATUS     0x01
+/* [motor:8] [on:8] */
+#define RPC_MOTOR_EN   0x02
+/* [motor:8] [speed:16], -INT16_MAX .. INT16_MAX */
+#define RPC_MOTOR_SET  0x03
+/* [loop:8] [kp:32] [ki:32] [kd:32] [ilimit:16], gains scaled by PID_SCALE */
+#define RPC_PID_GAINS  0x04
+/* [loop:8] [target:16] */
+#define RPC_PID_TARGET 0x05
+/* [loop:8] -> [kp:32] [ki:32] [kd:32] [ilimit:16] [target:16] */
+#define RPC_PID_GET    0x06
+/* [loop:8] [measured:16] -> [out:16]
+ * one step of the loop, out also goes to the motor of the same index */
+#define RPC_PID_STEP   0x07
+/* [clear:8] -> [rx_frame_err:8] [rx_overrun:8] [rx_parity:8] [rx_crc:8]
+ *              [rx_no_space:8] [rx_no_slot:8] [tx_drops:8] [tx_isr_idle:8]
+ *              [rx_bytes_hw:16] [rx_pkts_hw:8] [tx_bytes_hw:16] [tx_pkts_hw:8]
+ * the host link's struct frame_stats (frame_gen.h), zeroed after if clear */
+#define RPC_LINK_STATS 0x08
+#define RPC_LINK_STATS_LEN 14
+#define RPC_COUNT      9
+
+#endif
\ No newline at end of file
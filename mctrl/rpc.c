@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_async.h"
+#include "proto.h"
+#include "chan.h"
+#include "rpc.h"
+
+static const struct rpc_cmd *rpc_tbl;
+static uint8_t rpc_ct;
+static uint8_t drops;
+
+/* the request being answered */
+static uint8_t cur_cmd, cur_tag;
+static bool cur_started;
+
+void rpc_init(const struct rpc_cmd *tbl, uint8_t ct)
+{
+	rpc_tbl = tbl;
+	rpc_ct = ct;
+	drops = 0;
+}
+
+uint16_t rpc_arg_u16(const struct rpc_args *a, frame_len_t i)
+{
+	return (uint16_t)rpc_arg_u8(a, i) << 8 | rpc_arg_u8(a, i + 1);
+}
+
+uint32_t rpc_arg_u32(const struct rpc_args *a, frame_len_t i)
+{
+	return (uint32_t)rpc_arg_u16(a, i) << 16 | rpc_arg_u16(a, i + 2);
+}
+
+static void rpc_start(uint8_t status)
+{
+	chan_start(CHAN_RPC);
+	frame_append_u8(cur_cmd);
+	frame_append_u8(cur_tag);
+	frame_append_u8(status);
+	cur_started = true;
+}
+
+void rpc_put_u8(uint8_t x)
+{
+	if (!cur_started)
+		rpc_start(RPC_OK);
+	frame_append_u8(x);
+}
+
+void rpc_put_u16(uint16_t x)
+{
+	if (!cur_started)
+		rpc_start(RPC_OK);
+	frame_append_u16(x);
+}
+
+void rpc_put_u32(uint32_t x)
+{
+	rpc_put_u16((uint16_t)(x >> 16));
+	rpc_put_u16((uint16_t)x);
+}
+
+/* drop the first n (<= a->len) bytes of a */
+static void rpc_args_skip(struct rpc_args *a, uint8_t n)
+{
+	a->len -= n;
+	if (n >= a->seg[0].len) {
+		n -= a->seg[0].len;
+		a->seg[0].data = a->seg[1].data + n;
+		a->seg[0].len = a->seg[1].len - n;
+		a->seg[1].len = 0;
+	} else {
+		a->seg[0].data += n;
+		a->seg[0].len -= n;
+	}
+}
+
+void rpc_recv(uint8_t chan, const struct frame_seg *seg)
+{
+	struct rpc_args a = {
+		.seg = { seg[0], seg[1] },
+		.len = seg[0].len + seg[1].len,
+	};
+	rpc_fn fn = NULL;
+	uint8_t args = 0, status;
+
+	if (a.len < RPC_HDR_LEN) {
+		drops++;
+		return;
+	}
+	cur_cmd = rpc_arg_u8(&a, 0);
+	cur_tag = rpc_arg_u8(&a, 1);
+	cur_started = false;
+	rpc_args_skip(&a, RPC_HDR_LEN);
+
+	if (cur_cmd < rpc_ct) {
+#if defined(AVR)
+		fn = (rpc_fn)pgm_read_word(&rpc_tbl[cur_cmd].fn);
+		args = pgm_read_byte(&rpc_tbl[cur_cmd].args);
+#else
+		fn = rpc_tbl[cur_cmd].fn;
+		args = rpc_tbl[cur_cmd].args;
+#endif
+	}
+
+	if (!fn)
+		status = RPC_E_CMD;
+	else if (args != RPC_ARGS_ANY && args != a.len)
+		status = RPC_E_LEN;
+	else
+		status = fn(&a);
+
+	if (!cur_started)
+		rpc_start(status);
+	frame_done();
+}
+
+uint8_t rpc_link_stats(const struct rpc_args *a)
+{
+	struct frame_stats s;
+	frame_stats_get(&s, rpc_arg_u8(a, 0));
+	rpc_put_u8(s.rx_frame_err);
+	rpc_put_u8(s.rx_overrun);
+	rpc_put_u8(s.rx_parity);
+	rpc_put_u8(s.rx_crc);
+	rpc_put_u8(s.rx_no_space);
+	rpc_put_u8(s.rx_no_slot);
+	rpc_put_u8(s.tx_drops);
+	rpc_put_u8(s.tx_isr_idle);
+	rpc_put_u16(s.rx_bytes_hw);
+	rpc_put_u8(s.rx_pkts_hw);
+	rpc_put_u16(s.tx_bytes_hw);
+	rpc_put_u8(s.tx_pkts_hw);
+	return RPC_OK;
+}
+
+uint8_t rpc_drops(void)
+{
+	return drops;
+}
@@ -0,0 +1,79 @@
+#ifndef RPC_H_
+#define RPC_H_ 1
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_gen.h"
+#include "proto.h"
+
+/* Remote procedure calls on CHAN_RPC (wire format in proto.h).
+ *
+ * The cmd byte of a request indexes a const table of handlers, kept in
+ * flash on the AVR, so dispatch costs the same whatever the number of
+ * commands. Handlers read their arguments in place in the receive ring and
+ * put their reply straight into the transmit ring; neither is copied.
+ *
+ * Handlers run from chan_poll() and should be done well within the 1ms
+ * control tick (see tick.h): no waiting on the usart or anything else.
+ */
+
+#if defined(AVR)
+# include <avr/pgmspace.h>
+# define RPC_TABLE PROGMEM
+#else
+# define RPC_TABLE
+#endif
+
+/* the arguments of a request, following its header */
+struct rpc_args {
+	struct frame_seg seg[2];
+	frame_len_t len;
+};
+
+/* return: RPC_OK having put the reply with rpc_put_*(), or an RPC_E_*
+ *         having put nothing. */
+typedef uint8_t (*rpc_fn)(const struct rpc_args *a);
+
+/* for rpc_cmd.args, a handler which checks the length itself */
+#define RPC_ARGS_ANY 0xff
+
+struct rpc_cmd {
+	rpc_fn fn;
+	/* exact length of the args, RPC_ARGS_ANY to skip the check */
+	uint8_t args;
+};
+
+/* tbl: ct entries indexed by cmd, in RPC_TABLE memory. Entries with a NULL
+ *      fn (and cmds past the end) are answered with RPC_E_CMD.
+ */
+void rpc_init(const struct rpc_cmd *tbl, uint8_t ct);
+
+/* the chan_recv_fn for CHAN_RPC */
+void rpc_recv(uint8_t chan, const struct frame_seg *seg);
+
+/* i: offset into the args, must be < a->len (or a->len - 1, - 3 for the
+ *    wider ones). */
+static inline uint8_t rpc_arg_u8(const struct rpc_args *a, frame_len_t i)
+{
+	if (i < a->seg[0].len)
+		return a->seg[0].data[i];
+	return a->seg[1].data[i - a->seg[0].len];
+}
+
+uint16_t rpc_arg_u16(const struct rpc_args *a, frame_len_t i);
+uint32_t rpc_arg_u32(const struct rpc_args *a, frame_len_t i);
+
+/* append to the reply, the first put starts it with RPC_OK. Like
+ * frame_append_*(), a reply which doesn't fit in the tx ring is dropped.
+ * Nothing else may be sent until the handler returns. */
+void rpc_put_u8(uint8_t x);
+void rpc_put_u16(uint16_t x);
+void rpc_put_u32(uint32_t x);
+
+/* the handler of RPC_LINK_STATS, for any table to use (args 1) */
+uint8_t rpc_link_stats(const struct rpc_args *a);
+
+/* requests dropped for being too short to answer. Wraps. */
+uint8_t rpc_drops(void);
+
+#endif
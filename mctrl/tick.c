@@ -0,0 +1,55 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/power.h>
+
+#include "tick.h"
+
+/* prescale 64, CTC with top = OCR2A */
+#define TICK_PS 64
+#define TICK_TOP (F_CPU / TICK_PS / 1000 - 1)
+#if TICK_TOP > 0xff
+# error "F_CPU too high for an 8 bit 1ms tick at TICK_PS"
+#endif
+
+static volatile uint32_t ms_counter;
+
+ISR(TIMER2_COMPA_vect)
+{
+	ms_counter++;
+}
+
+void tick_init(void)
+{
+	power_timer2_enable();
+
+	/* Stop timer */
+	TCCR2B = 0;
+
+	OCR2A = TICK_TOP;
+	TCNT2 = 0;
+	ms_counter = 0;
+
+	/* OC2A/OC2B disconnected, CTC (top = OCR2A) */
+	TCCR2A = (0 << COM2A1) | (0 << COM2A0)
+		|(0 << COM2B1) | (0 << COM2B0)
+		|(1 << WGM21 ) | (0 << WGM20 );
+
+	TIFR2 = (1 << OCF2B) | (1 << OCF2A) | (1 << TOV2);
+	TIMSK2 = (1 << OCIE2A);
+
+	/* clkT2S/64 */
+	TCCR2B = (0 << WGM22)
+		| (1 << CS22) | (0 << CS21) | (0 << CS20);
+}
+
+uint32_t tick_ms(void)
+{
+	uint32_t s;
+	TIMSK2 &= ~(1 << OCIE2A);
+	asm("":::"memory");
+	s = ms_counter;
+	TIMSK2 |= (1 << OCIE2A);
+	asm("":::"memory");
+	return s;
+}
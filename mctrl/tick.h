@@ -0,0 +1,15 @@
+#ifndef TICK_H_
+#define TICK_H_ 1
+#include <stdint.h>
+
+/* 1ms system tick on timer 2, the control tick: the main loop runs each
+ * piece of work at least once per tick, so nothing it calls may take longer.
+ */
+
+/* start the tick, interrupts must be enabled for it to run */
+void tick_init(void);
+
+/* return: ms since tick_init(), wraps after ~49 days */
+uint32_t tick_ms(void);
+
+#endif